@@ -0,0 +1,380 @@
+//===- LatticeBench.cpp - Micro-benchmarks for the dataflow lattices ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Times join, equals, addInfo and removeInfo of each Info type on synthetic sets,
+// without loading an LLVM module. Build it against LLVMSupport only:
+//
+//   g++ -O2 -std=c++14 $(llvm-config --cxxflags) -Ipart3 bench/LatticeBench.cpp
+//       $(llvm-config --ldflags --libs support) -o lattice-bench
+//
+// and run ./lattice-bench [-min-time=<seconds>] [-filter=<substring>].
+// Each line reports one kernel on one input shape, with the average time and the
+// number of bytes allocated per operation.
+//
+// The shapes come from bench/lattice_shapes.py, run over the modules of bench/gen_ir.py
+// (sizes 20, 60 and 200) and over the OpenMP device runtime bitcode that LLVM 14 ships
+// (libomptarget-new-nvptx-sm_70.bc and libomptarget-new-amdgpu-gfx90a.bc), whose functions
+// stand in for real code. Measure again when the passes or their inputs change.
+//
+//===----------------------------------------------------------------------===//
+
+#include "231DFA.h"
+#include "MayPointToInfo.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<double> MinTime("min-time",
+                               cl::desc("Minimum time spent on each kernel, in seconds"),
+                               cl::init(0.2));
+static cl::opt<std::string> Filter("filter",
+                                   cl::desc("Only run kernels whose name contains this string"),
+                                   cl::init(""));
+
+
+/*
+ * Bytes handed out by operator new so far.
+ */
+static size_t BytesAllocated = 0;
+
+void * operator new(size_t size) {
+   BytesAllocated += size;
+   void * p = std::malloc(size ? size : 1);
+   if (p == nullptr)
+      report_bad_alloc_error("LatticeBench: out of memory");
+   return p;
+}
+
+void operator delete(void * p) noexcept {
+   std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+   std::free(p);
+}
+
+
+/*
+ * The sorted-vector sets the reaching and liveness passes used before BitVectorInfo,
+ * kept as a reference point for representation changes.
+ */
+class SortedVectorInfo : public Info {
+
+public:
+   std::vector<unsigned> v_info;
+
+   void print() {
+      print(errs());
+   }
+
+   void print(raw_ostream &OS) {
+      for(unsigned v : v_info) {
+         OS << v << "|";
+      }
+      OS << "\n";
+   }
+
+   void removeInfo(unsigned i) {
+      v_info.erase(std::remove(v_info.begin(), v_info.end(), i), v_info.end());
+   }
+
+   void addInfo(unsigned i) {
+      v_info.push_back(i);
+      std::sort(v_info.begin(), v_info.end());
+      v_info.erase(std::unique(v_info.begin(), v_info.end()), v_info.end());
+   }
+
+   static bool equals(SortedVectorInfo *info1, SortedVectorInfo *info2) {
+      return info1->v_info == info2->v_info;
+   }
+
+   static SortedVectorInfo* join(SortedVectorInfo *info1, SortedVectorInfo *info2, SortedVectorInfo *result) {
+      if(result == NULL || info1 == NULL || info2 == NULL) return NULL;
+
+      std::vector<unsigned> merged;
+      merged.reserve(info1->v_info.size() + info2->v_info.size());
+      merged.insert(merged.end(), info1->v_info.begin(), info1->v_info.end());
+      merged.insert(merged.end(), info2->v_info.begin(), info2->v_info.end());
+
+      std::sort(merged.begin(), merged.end());
+      merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+      result->v_info.swap(merged);
+      return result;
+   }
+};
+
+
+namespace {
+
+/*
+ * Keeps the compiler from dropping a computation whose result is otherwise unused.
+ */
+template <class T>
+void keep(const T & value) {
+   asm volatile("" : : "g"(&value) : "memory");
+}
+
+/*
+ * Shape of a random set of indices drawn from 0 .. Universe-1, and, for points-to sets,
+ * of Pointers registers each pointing to PerPointer of Universe memory objects.
+ */
+struct Shape {
+   unsigned Universe;
+   double Density;
+   unsigned Pointers;
+   unsigned PerPointer;
+};
+
+/*
+ * Functions of the runtime have a median of 23 instructions and a 90th percentile of 220,
+ * generated ones 362 and 3602. Liveness sets hold a median of 7% of the instructions in the
+ * runtime and 0.2% to 0.6% in generated code; reaching definitions hold 22% and 67%.
+ */
+std::vector<Shape> indexShapes() {
+   std::vector<Shape> shapes;
+   for (unsigned universe : {32u, 256u, 4096u})
+      for (double density : {0.005, 0.07, 0.22, 0.67})
+         shapes.push_back(Shape{universe, density, 0, 0});
+   return shapes;
+}
+
+/*
+ * Edges with facts hold a median of 9 pointers in the runtime and 43 in generated code,
+ * with 90th percentiles of 15 and 97. Nearly every pointer has one pointee; the most seen
+ * was 7.
+ */
+std::vector<Shape> pointsToShapes() {
+   std::vector<Shape> shapes;
+   for (unsigned pointers : {2u, 10u, 45u, 100u})
+      for (unsigned perPointer : {1u, 3u, 8u})
+         shapes.push_back(Shape{pointers * 4, 0, pointers, perPointer});
+   return shapes;
+}
+
+std::vector<unsigned> randomIndices(std::mt19937 & rng, const Shape & shape) {
+   std::vector<unsigned> indices;
+   std::bernoulli_distribution pick(shape.Density);
+   for (unsigned i = 0; i < shape.Universe; i++) {
+      if (pick(rng))
+         indices.push_back(i);
+   }
+   return indices;
+}
+
+void fill(BitVectorInfo & info, const std::vector<unsigned> & indices) {
+   for (unsigned i : indices)
+      info.addInfo(i);
+}
+
+void fill(SortedVectorInfo & info, const std::vector<unsigned> & indices) {
+   info.v_info = indices;
+}
+
+void randomPointsTo(std::mt19937 & rng, const Shape & shape, MayPointToInfo & info) {
+   std::uniform_int_distribution<unsigned> object(0, shape.Universe - 1);
+   for (unsigned p = 0; p < shape.Pointers; p++) {
+      for (unsigned k = 0; k < shape.PerPointer; k++)
+         info.addInfo(std::make_pair('R', p), std::make_pair('M', object(rng)));
+   }
+}
+
+typedef std::chrono::steady_clock Clock;
+
+/*
+ * Time taken by an empty timed region, subtracted from every measurement.
+ */
+Clock::duration clockOverhead() {
+   static Clock::duration overhead = []() {
+      const unsigned samples = 10000;
+      Clock::duration total(0);
+      for (unsigned i = 0; i < samples; i++) {
+         Clock::time_point start = Clock::now();
+         total += Clock::now() - start;
+      }
+      return total / samples;
+   }();
+   return overhead;
+}
+
+/*
+ * Run op over and over for at least MinTime seconds. op does `batch` operations per call
+ * and gets to prepare its input in setup, which is not timed.
+ */
+template <class Setup, class Op>
+void measure(StringRef kernel, StringRef type, const Shape & shape, unsigned batch, Setup setup, Op op) {
+   std::string name = (kernel + "/" + type).str();
+   if (name.find(Filter) == std::string::npos)
+      return;
+
+   Clock::duration elapsed(0);
+   size_t bytes = 0;
+   uint64_t ops = 0;
+   unsigned calls = 0;
+   while (ops == 0 || std::chrono::duration<double>(elapsed).count() < MinTime) {
+      setup();
+      size_t before = BytesAllocated;
+      Clock::time_point start = Clock::now();
+      op();
+      elapsed += Clock::now() - start;
+      bytes += BytesAllocated - before;
+      ops += batch;
+      calls++;
+   }
+
+   elapsed -= std::min<Clock::duration>(elapsed, calls * clockOverhead());
+   double ns = std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+   outs() << format("%-30s %8u ", name.c_str(), shape.Universe);
+   if (shape.Pointers)
+      outs() << format("%5u x %-3u ", shape.Pointers, shape.PerPointer);
+   else
+      outs() << format("%11.3f ", shape.Density);
+   outs() << format("%14.1f %12.1f\n", ns, (double)bytes / ops);
+}
+
+/*
+ * Kernels shared by the index set representations.
+ */
+template <class SetInfo>
+void benchIndexSet(StringRef type) {
+   std::mt19937 rng(231);
+   for (const Shape & shape : indexShapes()) {
+      SetInfo a, b, equal, result;
+      std::vector<unsigned> indices = randomIndices(rng, shape);
+      fill(a, indices);
+      fill(equal, indices);
+      fill(b, randomIndices(rng, shape));
+
+      measure("join", type, shape, 1,
+              [&]() { result = SetInfo(); },
+              [&]() { keep(SetInfo::join(&a, &b, &result)); });
+
+      measure("join-inplace", type, shape, 1,
+              [&]() { result = a; },
+              [&]() { keep(SetInfo::join(&result, &b, &result)); });
+
+      // Equal sets are the common (and most expensive) case at the fixpoint.
+      measure("equals", type, shape, 1,
+              []() {},
+              [&]() { keep(SetInfo::equals(&a, &equal)); });
+
+      // Batches stay small next to the set so the density barely drifts.
+      unsigned batch = std::max(1u, shape.Universe / 64);
+      std::uniform_int_distribution<unsigned> element(0, shape.Universe - 1);
+      std::vector<unsigned> elements(batch);
+
+      measure("addInfo", type, shape, batch,
+              [&]() {
+                 result = a;
+                 for (unsigned & e : elements)
+                    e = element(rng);
+              },
+              [&]() {
+                 for (unsigned e : elements)
+                    result.addInfo(e);
+                 keep(result);
+              });
+
+      if (indices.empty())
+         continue;
+      std::uniform_int_distribution<unsigned> member(0, indices.size() - 1);
+      measure("removeInfo", type, shape, batch,
+              [&]() {
+                 result = a;
+                 for (unsigned & e : elements)
+                    e = indices[member(rng)];
+              },
+              [&]() {
+                 for (unsigned e : elements)
+                    result.removeInfo(e);
+                 keep(result);
+              });
+   }
+}
+
+void benchPointsTo(StringRef type) {
+   std::mt19937 rng(231);
+   for (const Shape & shape : pointsToShapes()) {
+      MayPointToInfo a, b, result;
+      randomPointsTo(rng, shape, a);
+      randomPointsTo(rng, shape, b);
+
+      // An equal value built on its own, which does not share a's epoch, and one that
+      // differs from a by one pair.
+      MayPointToInfo equal, differ;
+      for (auto & val : a.info) {
+         for (unsigned pointee : val.second)
+            equal.addInfo(val.first, pointee);
+      }
+      differ = a;
+      differ.addInfo(std::make_pair('R', shape.Pointers), std::make_pair('M', 0u));
+      MayPointToInfo copy = a;
+
+      measure("join", type, shape, 1,
+              [&]() { result = MayPointToInfo(); },
+              [&]() { keep(MayPointToInfo::join(&a, &b, &result)); });
+
+      measure("join-inplace", type, shape, 1,
+              [&]() { result = a; },
+              [&]() { keep(MayPointToInfo::join(&result, &b, &result)); });
+
+      // equals() gives the values it finds equal a common epoch; start from a fresh copy.
+      MayPointToInfo scratch;
+      measure("equals", type, shape, 1,
+              [&]() { scratch = equal; },
+              [&]() { keep(MayPointToInfo::equals(&a, &scratch)); });
+
+      measure("equals-copy", type, shape, 1,
+              []() {},
+              [&]() { keep(MayPointToInfo::equals(&a, &copy)); });
+
+      measure("equals-differ", type, shape, 1,
+              []() {},
+              [&]() { keep(MayPointToInfo::equals(&a, &differ)); });
+
+      unsigned batch = std::max(1u, shape.Pointers / 16);
+      std::uniform_int_distribution<unsigned> pointer(0, shape.Pointers - 1);
+      std::uniform_int_distribution<unsigned> object(0, shape.Universe - 1);
+      std::vector<std::pair<pointerInfo_t, pointerInfo_t> > pairs(batch);
+
+      measure("addInfo", type, shape, batch,
+              [&]() {
+                 result = a;
+                 for (auto & p : pairs)
+                    p = std::make_pair(std::make_pair('R', pointer(rng)), std::make_pair('M', object(rng)));
+              },
+              [&]() {
+                 for (auto & p : pairs)
+                    result.addInfo(p.first, p.second);
+                 keep(result);
+              });
+   }
+}
+
+}
+
+int main(int argc, char ** argv) {
+   cl::ParseCommandLineOptions(argc, argv, "Micro-benchmarks for the dataflow lattices\n");
+
+   outs() << "kernel                         universe       shape          ns/op     bytes/op\n";
+   benchIndexSet<BitVectorInfo>("BitVectorInfo");
+   benchIndexSet<SortedVectorInfo>("SortedVectorInfo");
+   benchPointsTo("MayPointToInfo");
+   return 0;
+}
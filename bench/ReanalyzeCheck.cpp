@@ -0,0 +1,187 @@
+//===- ReanalyzeCheck.cpp - Compare reanalyze() with a fresh solve --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A test-only pass, cse231-reanalyze-check, that makes random edits to every function and
+// checks after each one that DataFlowAnalysis::reanalyze() prints the same results as
+// solving the edited function from scratch. It is built into a plugin of its own around
+// the source of the analysis under test, one of
+//
+//   g++ -O2 -std=c++14 -shared -fPIC $(llvm-config --cxxflags) -Ipart2 -DCHECK_REACHING
+//       bench/ReanalyzeCheck.cpp -o reanalyze-reaching.so
+//   g++ -O2 -std=c++14 -shared -fPIC $(llvm-config --cxxflags) -Ipart3 -DCHECK_LIVENESS
+//       bench/ReanalyzeCheck.cpp -o reanalyze-liveness.so
+//
+// and run by bench/check_reanalyze.py. Every mismatch is printed to stderr as a line
+// starting with "mismatch:".
+//
+//===----------------------------------------------------------------------===//
+
+#if defined(CHECK_REACHING)
+#include "ReachingDefinitionAnalysis.cpp"
+typedef ReachingInfo CheckedInfo;
+typedef ReachingAnalysis<ReachingInfo, true> CheckedAnalysis;
+#elif defined(CHECK_LIVENESS)
+#include "LivenessAnalysis.cpp"
+typedef LivenessInfo CheckedInfo;
+typedef LivenessAnalysis<LivenessInfo, false> CheckedAnalysis;
+#else
+#error "define CHECK_REACHING or CHECK_LIVENESS"
+#endif
+
+#include "llvm/IR/Constants.h"
+
+#include <random>
+#include <string>
+
+static cl::opt<unsigned> CheckSeed("reanalyze-seed",
+                                   cl::desc("Seed of the random edits of cse231-reanalyze-check"),
+                                   cl::init(1));
+static cl::opt<unsigned> CheckRounds("reanalyze-rounds",
+                                     cl::desc("Edits cse231-reanalyze-check makes to each function"),
+                                     cl::init(20));
+static cl::opt<bool> CheckIntern("reanalyze-intern",
+                                 cl::desc("Intern the values of the incrementally updated analysis"),
+                                 cl::init(false));
+
+
+namespace {
+   enum EditKind { INSERT, DELETE, OPERAND, BRANCH, NEW_PHI, NUM_EDIT_KINDS };
+
+   const char * editName(unsigned kind) {
+      static const char * names[] = { "insert", "delete", "operand", "branch", "new phi" };
+      return names[kind];
+   }
+
+   /*
+    * Make one random edit of the given kind to F, recording what it touched in Changed and
+    * Deleted the way reanalyze() expects. Returns false if the chosen instruction does not
+    * allow that kind of edit, in which case F is left as it was.
+    */
+   bool editFunction(Function &F, unsigned kind, std::mt19937 &rng,
+                     std::vector<Instruction *> &Changed, std::vector<Instruction *> &Deleted) {
+      std::vector<Instruction *> all;
+      for (Instruction &I : instructions(F))
+         all.push_back(&I);
+      Instruction *I = all[rng() % all.size()];
+      Type *i32 = Type::getInt32Ty(F.getContext());
+
+      switch (kind) {
+         case INSERT: {
+            if (isa<PHINode>(I))
+               I = I->getParent()->getFirstNonPHI();
+            Changed.push_back(BinaryOperator::Create(Instruction::Add, ConstantInt::get(i32, 1),
+                                                     ConstantInt::get(i32, 2), "", I));
+            return true;
+         }
+
+         case DELETE:
+            if (I->isTerminator() || !I->use_empty() || I->mayHaveSideEffects())
+               return false;
+            Deleted.push_back(I);
+            I->eraseFromParent();
+            return true;
+
+         // Use an earlier instruction of the same block and type as one of I's operands.
+         case OPERAND:
+            if (I->isTerminator() || isa<PHINode>(I))
+               return false;
+            for (unsigned k = 0; k < I->getNumOperands(); k++) {
+               Value *Op = I->getOperand(k);
+               for (Instruction &J : *I->getParent()) {
+                  if (&J == I)
+                     break;
+                  if (&J != Op && J.getType() == Op->getType()) {
+                     I->setOperand(k, &J);
+                     Changed.push_back(I);
+                     return true;
+                  }
+               }
+            }
+            return false;
+
+         // Send both arms of a conditional branch to its first successor.
+         case BRANCH: {
+            BranchInst *Br = dyn_cast<BranchInst>(I->getParent()->getTerminator());
+            if (!Br || !Br->isConditional())
+               return false;
+            BasicBlock *taken = Br->getSuccessor(0);
+            BasicBlock *dropped = Br->getSuccessor(1);
+            if (taken == dropped || isa<PHINode>(taken->front()) || isa<PHINode>(dropped->front()))
+               return false;
+            Br->setSuccessor(1, taken);
+            Changed.push_back(Br);
+            return true;
+         }
+
+         case NEW_PHI: {
+            BasicBlock *BB = I->getParent();
+            if (pred_begin(BB) == pred_end(BB))
+               return false;
+            PHINode *phi = PHINode::Create(i32, 2, "", &BB->front());
+            Constant *value = ConstantInt::get(i32, rng() % 7);
+            for (BasicBlock *pred : predecessors(BB))
+               phi->addIncoming(value, pred);
+            Changed.push_back(phi);
+            return true;
+         }
+      }
+      return false;
+   }
+
+   std::string printed(CheckedAnalysis &analysis) {
+      std::string text;
+      raw_string_ostream OS(text);
+      analysis.print(OS);
+      return OS.str();
+   }
+
+   struct ReanalyzeCheckPass : public FunctionPass {
+      public:
+         static char ID;
+         ReanalyzeCheckPass() : FunctionPass(ID) {}
+
+         bool runOnFunction(Function &F) override {
+            std::mt19937 rng(CheckSeed + std::hash<std::string>()(F.getName().str()));
+
+            CheckedInfo bott;
+            CheckedInfo init;
+            CheckedAnalysis analysis(bott, init);
+            analysis.setInterning(CheckIntern);
+            analysis.runWorklistAlgorithm(&F);
+
+            unsigned edits = 0;
+            for (unsigned round = 0; round < CheckRounds; round++) {
+               std::vector<Instruction *> changed;
+               std::vector<Instruction *> deleted;
+               unsigned kind = rng() % NUM_EDIT_KINDS;
+               if (!editFunction(F, kind, rng, changed, deleted))
+                  continue;
+               edits++;
+               analysis.reanalyze(&F, changed, deleted);
+
+               CheckedInfo freshBott;
+               CheckedInfo freshInit;
+               CheckedAnalysis fresh(freshBott, freshInit);
+               fresh.runWorklistAlgorithm(&F);
+               if (printed(analysis) != printed(fresh)) {
+                  errs() << "mismatch: " << F.getName() << " round " << round << " ("
+                         << editName(kind) << ")\n";
+               }
+            }
+            errs() << F.getName() << ": " << edits << " edits\n";
+            return true;
+         }
+   };
+}
+
+char ReanalyzeCheckPass::ID = 0;
+static RegisterPass<ReanalyzeCheckPass> Check("cse231-reanalyze-check",
+                                              "Compares reanalyze() after random edits with a fresh solve",
+                                              false /* Only looks at CFG */,
+                                              false /* Analysis Pass */);
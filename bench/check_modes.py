@@ -0,0 +1,339 @@
+#!/usr/bin/env python3
+#
+# Checks that the solver modes of the CSE 231 passes print the same results as the
+# default worklist.
+#
+#   check_modes.py --plugin cse231-reaching=path/to/reaching.so \
+#                  --plugin cse231-liveness=path/to/liveness.so ... [--opt opt] \
+#                  [--decode path/to/decode-results]
+#
+# Every --plugin names a registered pass and the shared object that provides it; passes
+# without a plugin are skipped. Each pass runs over the modules of bench/gen_ir.py and the
+# hand-written modules below, once by default and once per entry of MODES and of its
+# PASS_MODES, and any output that differs from the default run is reported. For each entry
+# of OUTPUT_MODES, the <pass>-module pass must print the same, and so must runs with
+# -<pass>-cache-dir, once to fill the cache, once to read it back and then with the stored
+# entries truncated. With --decode, the -<pass>-binary output, in full and for
+# -<pass>-query, must also decode to the text output. The exit status is 1 if anything
+# differed.
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_ir
+from scaling import legacy_pm_flags
+
+PASSES = ["cse231-reaching", "cse231-liveness", "cse231-maypointto"]
+
+# Flag sets that must not change the results of any pass; "{p}" is the flag prefix.
+MODES = [
+    ["-{p}-wto"],
+    ["-{p}-delta"],
+    ["-{p}-intern"],
+    ["-{p}-delta", "-{p}-intern"],
+    ["-{p}-boundary"],
+    ["-{p}-boundary", "-{p}-delta"],
+    ["-{p}-boundary", "-{p}-intern"],
+    ["-{p}-boundary", "-{p}-delta", "-{p}-intern"],
+]
+
+# Flag sets of modes that only some passes offer.
+PASS_MODES = {
+    "cse231-reaching": [
+        ["-{p}-block-summary"],
+        ["-{p}-boundary", "-{p}-block-summary"],
+    ],
+    "cse231-liveness": [
+        ["-{p}-block-summary"],
+        ["-{p}-boundary", "-{p}-block-summary"],
+    ],
+    "cse231-maypointto": [
+        ["-{p}-sparse"],
+        ["-{p}-andersen-seed"],
+        ["-{p}-sparse", "-{p}-andersen-seed"],
+    ],
+}
+
+# Flag sets under which the module pass, the cache and the binary output are checked too;
+# boundary mode replays blocks to print them.
+OUTPUT_MODES = [
+    [],
+    ["-{p}-boundary"],
+]
+
+# Instructions whose outgoing edges -<pass>-query asks for; indices past the end of a
+# function are skipped by both output formats.
+QUERY_POINTS = "1,3,4,9,17"
+
+SAMPLES = {
+    # Branches that join in phis, one of them fed from two blocks.
+    "diamonds": """define i32 @diamonds(i32 %n, i1 %c) {
+entry:
+  %a = add i32 %n, 1
+  %b = mul i32 %n, 2
+  br i1 %c, label %left, label %right
+left:
+  %l1 = add i32 %a, %b
+  %l2 = sub i32 %l1, 3
+  br label %join
+right:
+  %r1 = mul i32 %a, %a
+  br label %join
+join:
+  %x = phi i32 [ %l2, %left ], [ %r1, %right ]
+  %y = phi i32 [ %a, %left ], [ %b, %right ]
+  %z = add i32 %x, %y
+  %c2 = icmp sgt i32 %z, 0
+  br i1 %c2, label %then, label %done
+then:
+  %w = add i32 %z, %b
+  br label %done
+done:
+  %r = phi i32 [ %w, %then ], [ %z, %join ]
+  ret i32 %r
+}
+""",
+    # Loops nested three deep, so inner components are stabilized again on every iteration
+    # of the outer ones.
+    "nested-loops": """define i32 @nest(i32 %n, i32* %p) {
+entry:
+  br label %outer
+outer:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %outer.latch ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.mid, %outer.latch ]
+  br label %middle
+middle:
+  %j = phi i32 [ 0, %outer ], [ %j.next, %middle.latch ]
+  %acc.mid = phi i32 [ %acc, %outer ], [ %acc.in, %middle.latch ]
+  %t = mul i32 %i, %j
+  br label %inner
+inner:
+  %k = phi i32 [ 0, %middle ], [ %k.next, %inner ]
+  %acc.in = phi i32 [ %acc.mid, %middle ], [ %sum, %inner ]
+  %v = load i32, i32* %p
+  %sum = add i32 %acc.in, %v
+  store i32 %t, i32* %p
+  %k.next = add i32 %k, 1
+  %ck = icmp slt i32 %k.next, %n
+  br i1 %ck, label %inner, label %middle.latch
+middle.latch:
+  %j.next = add i32 %j, 1
+  %cj = icmp slt i32 %j.next, %n
+  br i1 %cj, label %middle, label %outer.latch
+outer.latch:
+  %i.next = add i32 %i, 1
+  %ci = icmp slt i32 %i.next, %n
+  br i1 %ci, label %outer, label %exit
+exit:
+  ret i32 %acc.mid
+}
+""",
+    # Pointer facts flowing through branches, a loop and a phi, mixed with arguments and a
+    # global that have no node of their own; sparse mode forwards the facts past the
+    # arithmetic, and the Andersen seed prunes what cannot point anywhere.
+    "pointer-flow": """@g = global i32* null
+
+define i32* @h(i1 %c, i32* %arg, i32** %pp) {
+entry:
+  %a = alloca i32
+  %b = alloca i32
+  %s = alloca i32*
+  %t = alloca i32**
+  store i32* %a, i32** %s
+  store i32** %s, i32*** %t
+  store i32* %arg, i32** %s
+  %n = add i32 1, 2
+  br i1 %c, label %l, label %r
+l:
+  store i32* %b, i32** %s
+  %m = mul i32 %n, 3
+  br label %loop
+r:
+  %x = load i32*, i32** %pp
+  store i32* %x, i32** @g
+  br label %loop
+loop:
+  %p = phi i32* [ %a, %l ], [ %b, %r ], [ %q, %loop ]
+  %ss = load i32**, i32*** %t
+  %q = load i32*, i32** %ss
+  %k = add i32 %n, 1
+  %w = select i1 %c, i32* %p, i32* %q
+  %e = bitcast i32* %w to i8*
+  store i32* %w, i32** %ss
+  br i1 %c, label %loop, label %exit
+exit:
+  %y = load i32*, i32** @g
+  ret i32* %w
+}
+""",
+    # The join block's instructions push one shared value onto every outgoing edge; delta
+    # mode with interning must not free it after the first edge.
+    "shared-outputs": """declare void @f()
+
+define i32 @g(i1 %c, i32 %x) {
+entry:
+  %a = add i32 %x, 1
+  br i1 %c, label %l, label %r
+l:
+  br label %m
+r:
+  br label %m
+m:
+  call void @f()
+  ret i32 %a
+}
+""",
+}
+
+
+def run(command):
+    """Run command, returning its stderr, where the passes print, or None if it failed."""
+    proc = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    return proc.stderr if proc.returncode == 0 else None
+
+
+def check_binary(command, prefix, decode, path):
+    """Compare the text output of command, in full and for QUERY_POINTS, with its
+    -<pass>-binary output decoded by decode, and return what went wrong."""
+    problems = []
+    for what, flags in [("results", []), ("query results", ["-%s-query=%s" % (prefix, QUERY_POINTS)])]:
+        text = run(command[:-1] + flags + command[-1:])
+        binary = command[:-1] + flags + ["-%s-binary" % prefix, "-%s-output=%s" % (prefix, path)] + command[-1:]
+        if text is None or run(binary) is None:
+            problems.append("%s: run failed" % what)
+            continue
+        proc = subprocess.run([decode, path], stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+        if proc.returncode != 0 or proc.stdout != text:
+            problems.append("decoded binary %s differ from the text ones" % what)
+    return problems
+
+
+def check_cache(command, prefix, expected, cache_dir):
+    """Run command with an empty cache, then with the entries it stored, then with those
+    entries truncated, and return what went wrong."""
+    with_cache = command[:-1] + ["-%s-cache-dir=%s" % (prefix, cache_dir)] + command[-1:]
+    problems = []
+    for step in ["cache miss", "cache hit"]:
+        if run(with_cache) != expected:
+            problems.append("%s differs from the default" % step)
+
+    entries = {}
+    for entry in os.listdir(cache_dir) if os.path.isdir(cache_dir) else []:
+        if entry.startswith("cse231-" + prefix + "-"):
+            path = os.path.join(cache_dir, entry)
+            entries[path] = os.path.getsize(path)
+    if not entries:
+        return problems + ["nothing was cached"]
+
+    # A truncated entry must be recomputed, and stored again in full.
+    for cut in [lambda size: size - 1, lambda size: size // 2]:
+        for path, size in entries.items():
+            os.truncate(path, cut(size))
+        if run(with_cache) != expected:
+            problems.append("truncated cache entries give other results")
+        if any(os.path.getsize(path) != size for path, size in entries.items()):
+            problems.append("truncated cache entries were not stored again")
+    return problems
+
+
+def check_unwritable(command, prefix, path):
+    """Run command and its module pass with -<pass>-stats and -<pass>-output at path, which
+    cannot be written, and return what went wrong. The runs must succeed and report the
+    error once."""
+    problems = []
+    module_pass = ["-cse231-%s-module" % prefix if arg == "-cse231-" + prefix else arg for arg in command]
+    for what, run_command in [("function pass", command), ("module pass", module_pass)]:
+        for option in ["stats", "output"]:
+            stderr = run(run_command[:-1] + ["-%s-%s=%s" % (prefix, option, path)] + run_command[-1:])
+            if stderr is None:
+                problems.append("%s fails with an unwritable %s file" % (what, option))
+            elif stderr.count(b"error: cannot write") != 1:
+                problems.append("%s does not report an unwritable %s file once" % (what, option))
+    return problems
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Checks the solver modes of the CSE 231 passes.")
+    parser.add_argument("--plugin", action="append", default=[], metavar="PASS=SO",
+                        help="shared object providing a pass, e.g. cse231-liveness=liveness.so")
+    parser.add_argument("--opt", default="opt", help="opt binary to load the plugins into")
+    parser.add_argument("--sizes", default="20,60", help="comma separated gen_ir.py sizes")
+    parser.add_argument("--decode", help="decode-results built from tools/DecodeResults.cpp; "
+                        "without it the binary output is not checked")
+    args = parser.parse_args()
+
+    plugins = {}
+    for spec in args.plugin:
+        name, _, path = spec.partition("=")
+        if not path:
+            parser.error("--plugin expects PASS=SO, got %r" % spec)
+        plugins[name] = os.path.abspath(path)
+    passes = [p for p in PASSES if p in plugins]
+    if not passes:
+        parser.error("no --plugin given for %s" % ", ".join(PASSES))
+
+    base = [args.opt] + legacy_pm_flags(args.opt)
+    failures = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        modules = sorted(SAMPLES.items())
+        sizes = [int(s) for s in args.sizes.split(",")]
+        for shape in sorted(gen_ir.SHAPES):
+            for size in sizes:
+                modules.append(("%s-%d" % (shape, size), gen_ir.generate(shape, size, functions=2)))
+        for size in sizes:
+            modules.append(("loops-deep-%d" % size, gen_ir.generate("loops", size, depth=3, functions=2)))
+
+        for name, text in modules:
+            module = os.path.join(tmp, name + ".ll")
+            with open(module, "w") as f:
+                f.write(text)
+
+            for pass_name in passes:
+                prefix = pass_name[len("cse231-"):]
+                command = base + ["-load", plugins[pass_name], "-" + pass_name, "-disable-output", module]
+                expected = run(command)
+                if expected is None:
+                    print("%s %s: default run failed" % (pass_name, name), file=sys.stderr)
+                    failures += 1
+                    continue
+
+                for mode in MODES + PASS_MODES.get(pass_name, []):
+                    flags = [flag.format(p=prefix) for flag in mode]
+                    if run(command[:-1] + flags + [module]) != expected:
+                        print("%s %s %s: differs from the default" % (pass_name, name, " ".join(flags)),
+                              file=sys.stderr)
+                        failures += 1
+
+                if name == modules[0][0]:
+                    for problem in check_unwritable(command, prefix, os.path.join(tmp, "missing", "stats")):
+                        print("%s %s: %s" % (pass_name, name, problem), file=sys.stderr)
+                        failures += 1
+
+                for mode in OUTPUT_MODES:
+                    flags = [flag.format(p=prefix) for flag in mode]
+                    where = " ".join([pass_name, name] + flags)
+                    problems = []
+                    # The module pass analyzes the functions concurrently but prints them in order.
+                    module_pass = ["-%s-module" % pass_name if arg == "-" + pass_name else arg for arg in command]
+                    if run(module_pass[:-1] + flags + [module]) != expected:
+                        problems.append("%s-module differs from the default" % pass_name)
+                    if args.decode:
+                        problems += check_binary(command[:-1] + flags + [module], prefix,
+                                                 os.path.abspath(args.decode), os.path.join(tmp, "results.bin"))
+                    problems += check_cache(command[:-1] + flags + [module], prefix, expected,
+                                            os.path.join(tmp, "cache-%s-%s-%d" % (prefix, name, len(flags))))
+                    for problem in problems:
+                        print("%s: %s" % (where, problem), file=sys.stderr)
+                        failures += 1
+
+    print("%d mismatches" % failures, file=sys.stderr)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
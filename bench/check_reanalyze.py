@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# Checks that DataFlowAnalysis::reanalyze() gives the same results as a fresh solve after
+# random edits, through the cse231-reanalyze-check pass of bench/ReanalyzeCheck.cpp.
+#
+#   check_reanalyze.py --plugin cse231-reaching=path/to/reanalyze-reaching.so \
+#                      --plugin cse231-liveness=path/to/reanalyze-liveness.so [--opt opt]
+#
+# Every --plugin names the analysis a ReanalyzeCheck.cpp plugin was built around; only
+# reaching definitions and liveness support structural edits. Each plugin runs over the
+# modules of bench/gen_ir.py once per seed, with and without interning, and every mismatch
+# the pass reports is printed. The exit status is 1 if there was one or a run failed.
+#
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_ir
+from scaling import legacy_pm_flags
+
+PASSES = ["cse231-reaching", "cse231-liveness"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Checks reanalyze() against a fresh solve.")
+    parser.add_argument("--plugin", action="append", default=[], metavar="PASS=SO",
+                        help="ReanalyzeCheck.cpp plugin of a pass, e.g. cse231-liveness=reanalyze-liveness.so")
+    parser.add_argument("--opt", default="opt", help="opt binary to load the plugins into")
+    parser.add_argument("--sizes", default="10,40", help="comma separated gen_ir.py sizes")
+    parser.add_argument("--seeds", type=int, default=3, help="edit sequences per module")
+    parser.add_argument("--rounds", type=int, default=40, help="edits per function and seed")
+    args = parser.parse_args()
+
+    plugins = {}
+    for spec in args.plugin:
+        name, _, path = spec.partition("=")
+        if not path:
+            parser.error("--plugin expects PASS=SO, got %r" % spec)
+        plugins[name] = os.path.abspath(path)
+    passes = [p for p in PASSES if p in plugins]
+    if not passes:
+        parser.error("no --plugin given for %s" % ", ".join(PASSES))
+
+    base = [args.opt] + legacy_pm_flags(args.opt)
+    failures = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        modules = []
+        for shape in sorted(gen_ir.SHAPES):
+            for size in [int(s) for s in args.sizes.split(",")]:
+                modules.append(("%s-%d" % (shape, size), gen_ir.generate(shape, size, functions=2)))
+
+        for name, text in modules:
+            module = os.path.join(tmp, name + ".ll")
+            with open(module, "w") as f:
+                f.write(text)
+
+            for pass_name in passes:
+                for seed in range(1, args.seeds + 1):
+                    for intern in [[], ["-reanalyze-intern"]]:
+                        flags = ["-reanalyze-seed=%d" % seed, "-reanalyze-rounds=%d" % args.rounds] + intern
+                        command = base + ["-load", plugins[pass_name], "-cse231-reanalyze-check"] + flags + \
+                            ["-disable-output", module]
+                        proc = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                                              universal_newlines=True)
+                        where = "%s %s %s" % (pass_name, name, " ".join(flags))
+                        if proc.returncode != 0:
+                            print("%s: run failed" % where, file=sys.stderr)
+                            failures += 1
+                            continue
+                        for line in proc.stderr.splitlines():
+                            if line.startswith("mismatch:"):
+                                print("%s: %s" % (where, line), file=sys.stderr)
+                                failures += 1
+
+    print("%d mismatches" % failures, file=sys.stderr)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+#
+# Generates a synthetic LLVM module of a given shape and size for the scaling benchmark.
+#
+#   gen_ir.py SHAPE SIZE [--depth D] [--width W] [--density P] [--functions F] [--seed S]
+#
+# Shapes:
+#   straight  one block of SIZE arithmetic instructions
+#   diamonds  a chain of SIZE if/else diamonds, each joined by a phi
+#   loops     SIZE loop nests in sequence, each DEPTH loops deep
+#   phis      SIZE diamonds inside one loop, each joining WIDTH values with phis
+#   pointers  SIZE instructions, a DENSITY fraction of them allocas, loads, stores,
+#             getelementptrs, bitcasts, selects and phis on pointers
+#
+# The module is written to stdout. Its first line is a comment with the shape and the
+# number of blocks and instructions, which bench/scaling.py reads back.
+#
+
+import argparse
+import random
+
+
+class Function:
+    def __init__(self, name):
+        self.name = name
+        self.lines = []
+        self.blocks = 0
+        self.instructions = 0
+        self.counter = 0
+
+    def fresh(self, prefix):
+        self.counter += 1
+        return "%%%s%d" % (prefix, self.counter)
+
+    def block(self, label):
+        self.lines.append("%s:" % label)
+        self.blocks += 1
+
+    def emit(self, text):
+        self.lines.append("  " + text)
+        self.instructions += 1
+
+    def value(self, prefix, text):
+        name = self.fresh(prefix)
+        self.emit("%s = %s" % (name, text))
+        return name
+
+    def arith(self, rng, a, b):
+        return self.value("v", "%s i32 %s, %s" % (rng.choice(["add", "sub", "mul", "xor"]), a, b))
+
+
+def straight(f, rng, args):
+    f.block("entry")
+    values = ["%n"]
+    for _ in range(args.size):
+        values.append(f.arith(rng, rng.choice(values[-4:]), rng.choice(values[-4:] + ["1"])))
+    f.emit("ret i32 %s" % values[-1])
+
+
+def diamonds(f, rng, args):
+    f.block("entry")
+    v = "%n"
+    f.emit("br label %d0")
+    for i in range(args.size):
+        f.block("d%d" % i)
+        c = f.value("c", "icmp slt i32 %s, %d" % (v, rng.randint(0, 100)))
+        f.emit("br i1 %s, label %%t%d, label %%e%d" % (c, i, i))
+        f.block("t%d" % i)
+        a = f.arith(rng, v, "1")
+        f.emit("br label %%j%d" % i)
+        f.block("e%d" % i)
+        b = f.arith(rng, v, "3")
+        f.emit("br label %%j%d" % i)
+        f.block("j%d" % i)
+        v = f.value("m", "phi i32 [ %s, %%t%d ], [ %s, %%e%d ]" % (a, i, b, i))
+        f.emit("br label %%%s" % ("d%d" % (i + 1) if i + 1 < args.size else "exit"))
+    f.block("exit")
+    f.emit("ret i32 %s" % v)
+
+
+def loop_nest(f, rng, prefix, depth, acc, pred, exit_label):
+    """Emit a loop nest entered from pred and left to exit_label.
+    Returns the block that branches to exit_label and the accumulated value."""
+    header = prefix + ".h"
+    latch = prefix + ".latch"
+    iv = "%" + prefix + ".iv"
+    ivn = "%" + prefix + ".ivn"
+    accn = "%" + prefix + ".accn"
+
+    f.block(header)
+    f.emit("%s = phi i32 [ 0, %%%s ], [ %s, %%%s ]" % (iv, pred, ivn, latch))
+    phi = "%" + prefix + ".acc"
+    f.emit("%s = phi i32 [ %s, %%%s ], [ %s, %%%s ]" % (phi, acc, pred, accn, latch))
+    body = f.arith(rng, phi, iv)
+    body = f.arith(rng, body, "7")
+    if depth > 1:
+        inner = prefix + ".0"
+        f.emit("br label %%%s.h" % inner)
+        _, body = loop_nest(f, rng, inner, depth - 1, body, header, latch)
+    else:
+        f.emit("br label %%%s" % latch)
+
+    f.block(latch)
+    f.emit("%s = add i32 %s, %s" % (accn, body, iv))
+    f.emit("%s = add i32 %s, 1" % (ivn, iv))
+    c = f.value("c", "icmp slt i32 %s, %%n" % ivn)
+    f.emit("br i1 %s, label %%%s, label %%%s" % (c, header, exit_label))
+    return latch, accn
+
+
+def loops(f, rng, args):
+    f.block("entry")
+    f.emit("br label %n0.h")
+    acc, pred = "%n", "entry"
+    for i in range(args.size):
+        exit_label = "n%d.h" % (i + 1) if i + 1 < args.size else "exit"
+        pred, acc = loop_nest(f, rng, "n%d" % i, args.depth, acc, pred, exit_label)
+    f.block("exit")
+    f.emit("ret i32 %s" % acc)
+
+
+def phis(f, rng, args):
+    width = args.width
+    f.block("entry")
+    f.emit("br label %loop")
+
+    f.block("loop")
+    carried = ["%%p%d" % k for k in range(width)]
+    nexts = ["%%p%d.next" % k for k in range(width)]
+    for k in range(width):
+        f.emit("%s = phi i32 [ %d, %%entry ], [ %s, %%latch ]" % (carried[k], k, nexts[k]))
+    f.emit("br label %d0")
+
+    values = carried
+    for i in range(args.size):
+        f.block("d%d" % i)
+        c = f.value("c", "icmp slt i32 %s, %s" % (values[0], values[-1]))
+        f.emit("br i1 %s, label %%t%d, label %%e%d" % (c, i, i))
+        f.block("t%d" % i)
+        a = [f.arith(rng, values[k], values[(k + 1) % width]) for k in range(width)]
+        f.emit("br label %%j%d" % i)
+        f.block("e%d" % i)
+        b = [f.arith(rng, values[k], values[(k + width - 1) % width]) for k in range(width)]
+        f.emit("br label %%j%d" % i)
+        f.block("j%d" % i)
+        values = [f.value("m", "phi i32 [ %s, %%t%d ], [ %s, %%e%d ]" % (a[k], i, b[k], i))
+                  for k in range(width)]
+        f.emit("br label %%%s" % ("d%d" % (i + 1) if i + 1 < args.size else "latch"))
+
+    f.block("latch")
+    for k in range(width):
+        f.emit("%s = add i32 %s, 1" % (nexts[k], values[k]))
+    c = f.value("c", "icmp slt i32 %s, %%n" % nexts[0])
+    f.emit("br i1 %s, label %%loop, label %%exit" % c)
+    f.block("exit")
+    f.emit("ret i32 %s" % nexts[-1])
+
+
+def pointers(f, rng, args):
+    f.block("entry")
+    objects = [f.value("a", "alloca i32") for _ in range(max(2, int(args.size * args.density) // 8))]
+    slots = [f.value("s", "alloca i32*") for _ in range(max(1, len(objects) // 2))]
+    for s in slots:
+        f.emit("store i32* %s, i32** %s" % (rng.choice(objects), s))
+    c = f.value("c", "icmp sgt i32 %n, 0")
+
+    ptrs = objects + ["%arg"]
+    ints = ["%n"]
+    block = 0
+    for i in range(args.size):
+        # Split the code into diamonds so pointers also flow through phis.
+        if i % 16 == 15:
+            p, q = rng.choice(ptrs), rng.choice(ptrs)
+            f.emit("br i1 %s, label %%t%d, label %%e%d" % (c, block, block))
+            f.block("t%d" % block)
+            a = f.value("g", "getelementptr i32, i32* %s, i32 1" % p)
+            f.emit("br label %%j%d" % block)
+            f.block("e%d" % block)
+            f.emit("br label %%j%d" % block)
+            f.block("j%d" % block)
+            ptrs.append(f.value("p", "phi i32* [ %s, %%t%d ], [ %s, %%e%d ]" % (a, block, q, block)))
+            block += 1
+            continue
+
+        if rng.random() >= args.density:
+            ints.append(f.arith(rng, rng.choice(ints[-4:]), "1"))
+            continue
+
+        op = rng.choice(["load", "store", "gep", "bitcast", "select", "loadint"])
+        if op == "load":
+            ptrs.append(f.value("l", "load i32*, i32** %s" % rng.choice(slots)))
+        elif op == "store":
+            f.emit("store i32* %s, i32** %s" % (rng.choice(ptrs), rng.choice(slots)))
+        elif op == "gep":
+            ptrs.append(f.value("g", "getelementptr i32, i32* %s, i32 %d" % (rng.choice(ptrs), rng.randint(0, 3))))
+        elif op == "bitcast":
+            f.value("b", "bitcast i32* %s to i8*" % rng.choice(ptrs))
+        elif op == "select":
+            ptrs.append(f.value("x", "select i1 %s, i32* %s, i32* %s" % (c, rng.choice(ptrs), rng.choice(ptrs))))
+        else:
+            ints.append(f.value("i", "load i32, i32* %s" % rng.choice(ptrs)))
+    f.emit("ret i32 %s" % ints[-1])
+
+
+SHAPES = {
+    "straight": straight,
+    "diamonds": diamonds,
+    "loops": loops,
+    "phis": phis,
+    "pointers": pointers,
+}
+
+
+def generate(shape, size, depth=2, width=8, density=0.5, functions=1, seed=1):
+    """Return the text of the module."""
+    args = argparse.Namespace(size=size, depth=depth, width=width, density=density)
+    rng = random.Random(seed)
+    bodies = []
+    blocks = instructions = 0
+    for k in range(functions):
+        f = Function("f%d" % k)
+        SHAPES[shape](f, rng, args)
+        blocks += f.blocks
+        instructions += f.instructions
+        bodies.append("define i32 @%s(i32 %%n, i32* %%arg) {\n%s\n}\n" % (f.name, "\n".join(f.lines)))
+
+    header = "; shape=%s size=%d depth=%d width=%d density=%g functions=%d blocks=%d instructions=%d\n" % (
+        shape, size, depth, width, density, functions, blocks, instructions)
+    return header + "\n".join(bodies)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate a synthetic LLVM module.")
+    parser.add_argument("shape", choices=sorted(SHAPES))
+    parser.add_argument("size", type=int)
+    parser.add_argument("--depth", type=int, default=2, help="loop nesting depth (loops)")
+    parser.add_argument("--width", type=int, default=8, help="phis per join (phis)")
+    parser.add_argument("--density", type=float, default=0.5, help="fraction of pointer instructions (pointers)")
+    parser.add_argument("--functions", type=int, default=1, help="copies of the function in the module")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+    print(generate(args.shape, args.size, args.depth, args.width, args.density, args.functions, args.seed), end="")
+
+
+if __name__ == "__main__":
+    main()
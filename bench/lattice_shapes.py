@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+#
+# Measures the sets the lattice kernels see in practice, to pick the shapes of
+# bench/LatticeBench.cpp from.
+#
+#   lattice_shapes.py --plugin cse231-reaching=path/to/reaching.so \
+#                     --plugin cse231-liveness=path/to/liveness.so ... [module.ll|.bc ...]
+#
+# Every --plugin names a pass and the shared object that provides it; passes without a
+# plugin are skipped. Each pass runs over the modules given and over modules of
+# bench/gen_ir.py, and the printed edge facts are read back. For reaching definitions and
+# liveness, the universe of a set is the number of instructions of its function (from
+# -<pass>-stats) and its density the fraction of them in the set. For may-point-to, a set is
+# the pointers of an edge and the pointees of each. The 10th, 50th and 90th percentiles and
+# the maximum are printed; densities and pointer counts are over the edges with a non-empty
+# set, and the share of empty ones is given apart.
+#
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_ir
+from scaling import legacy_pm_flags
+
+PASSES = ["cse231-reaching", "cse231-liveness", "cse231-maypointto"]
+
+
+def percentiles(values):
+    """The 10th, 50th and 90th percentiles and the maximum of values, nearest rank."""
+    if not values:
+        return [0, 0, 0, 0]
+    values = sorted(values)
+    return [values[min(len(values) - 1, len(values) * p // 100)] for p in (10, 50, 90)] + [values[-1]]
+
+
+def functions(text):
+    """Split the output of a pass into the facts of each function, one string per edge.
+    Every function prints the edge leaving the dummy node 0 once."""
+    result = []
+    for line in text.splitlines():
+        if not line.startswith("Edge "):
+            continue
+        if line.startswith("Edge 0->"):
+            result.append([])
+        if result:
+            result[-1].append(line.partition(":")[2])
+    return result
+
+
+def measure(pass_name, facts, stats):
+    """Rows of (quantity, values) for the edge facts and stats of every function."""
+    if pass_name == "cse231-maypointto":
+        pointers, pointees, empty = [], [], 0
+        for edges in facts:
+            for fact in edges:
+                entries = [e for e in fact.split("|") if e]
+                if not entries:
+                    empty += 1
+                    continue
+                pointers.append(len(entries))
+                pointees += [e.count("/") for e in entries]
+        total = len(pointers) + empty
+        return [("pointers per edge", pointers), ("pointees per pointer", pointees)], empty, total
+
+    universes, densities, empty = [], [], 0
+    for edges, line in zip(facts, stats):
+        universe = line["instructions"]
+        universes.append(universe)
+        for fact in edges:
+            size = len([i for i in fact.split("|") if i])
+            if size == 0:
+                empty += 1
+            elif universe:
+                densities.append(size / universe)
+    total = len(densities) + empty
+    return [("instructions per function", universes), ("density", densities)], empty, total
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measures the sets the lattice kernels see.")
+    parser.add_argument("--plugin", action="append", default=[], metavar="PASS=SO",
+                        help="shared object providing a pass, e.g. cse231-liveness=liveness.so")
+    parser.add_argument("--opt", default="opt", help="opt binary to load the plugins into")
+    parser.add_argument("--sizes", default="20,60,200",
+                        help="comma separated gen_ir.py sizes, or empty for none")
+    parser.add_argument("modules", nargs="*", help="further modules to measure, .ll or .bc")
+    args = parser.parse_args()
+
+    plugins = {}
+    for spec in args.plugin:
+        name, _, path = spec.partition("=")
+        if not path:
+            parser.error("--plugin expects PASS=SO, got %r" % spec)
+        plugins[name] = os.path.abspath(path)
+    passes = [p for p in PASSES if p in plugins]
+    if not passes:
+        parser.error("no --plugin given for %s" % ", ".join(PASSES))
+
+    base = [args.opt] + legacy_pm_flags(args.opt)
+    with tempfile.TemporaryDirectory() as tmp:
+        modules = [os.path.abspath(m) for m in args.modules]
+        for shape in sorted(gen_ir.SHAPES):
+            for size in [int(s) for s in args.sizes.split(",") if s]:
+                path = os.path.join(tmp, "%s-%d.ll" % (shape, size))
+                with open(path, "w") as f:
+                    f.write(gen_ir.generate(shape, size, functions=2))
+                modules.append(path)
+
+        for pass_name in passes:
+            prefix = pass_name[len("cse231-"):]
+            facts, stats = [], []
+            for module in modules:
+                stats_file = os.path.join(tmp, "stats.jsonl")
+                if os.path.exists(stats_file):
+                    os.remove(stats_file)
+                command = base + ["-load", plugins[pass_name], "-" + pass_name,
+                                  "-%s-stats=%s" % (prefix, stats_file), "-disable-output", module]
+                proc = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE,
+                                      universal_newlines=True)
+                if proc.returncode != 0:
+                    print("%s %s: run failed" % (pass_name, module), file=sys.stderr)
+                    continue
+                facts += functions(proc.stderr)
+                with open(stats_file) as f:
+                    stats += [json.loads(line) for line in f]
+
+            rows, empty, total = measure(pass_name, facts, stats)
+            print("%s: %d functions, %d edges, %.0f%% empty" %
+                  (pass_name, len(facts), total, 100.0 * empty / total if total else 0))
+            for quantity, values in rows:
+                p10, p50, p90, top = percentiles(values)
+                fmt = "%.3f" if any(isinstance(v, float) for v in values) else "%d"
+                print(("  %-28s p10 " + fmt + "  p50 " + fmt + "  p90 " + fmt + "  max " + fmt) %
+                      (quantity, p10, p50, p90, top))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+#
+# Runs each pass over synthetic modules of growing size and records wall time and peak RSS.
+#
+#   scaling.py --plugin cse231-reaching=path/to/reaching.so \
+#              --plugin cse231-liveness=path/to/liveness.so ... [options] > scaling.csv
+#
+# Every --plugin names a registered pass and the shared object that provides it; passes
+# without a plugin are skipped. Modules come from bench/gen_ir.py. The CSV has one row per
+# (pass, shape, size) in a fixed order and no timestamps, so the files of two revisions can
+# be diffed directly.
+#
+
+import argparse
+import csv
+import os
+import re
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_ir
+
+PASSES = ["cse231-csi", "cse231-reaching", "cse231-liveness", "cse231-maypointto"]
+
+FIELDS = ["pass", "shape", "size", "depth", "width", "density", "functions",
+          "blocks", "instructions", "seconds", "peak_rss_kb", "status"]
+
+
+def legacy_pm_flags(opt):
+    """The legacy passes need -enable-new-pm=0 from LLVM 13 on."""
+    out = subprocess.run([opt, "--version"], stdout=subprocess.PIPE, universal_newlines=True).stdout
+    match = re.search(r"LLVM version (\d+)", out)
+    if match and int(match.group(1)) >= 13:
+        return ["-enable-new-pm=0"]
+    return []
+
+
+def run_once(command, timeout):
+    """Run command, returning (seconds, peak RSS in KB, status)."""
+    start = time.perf_counter()
+    proc = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    timer = threading.Timer(timeout, proc.kill)
+    timer.start()
+    # wait4 gives the resource usage of this child alone.
+    _, status, usage = os.wait4(proc.pid, 0)
+    seconds = time.perf_counter() - start
+    expired = not timer.is_alive()
+    timer.cancel()
+    # The child is already reaped; keep Popen from waiting for it again.
+    proc.returncode = os.waitstatus_to_exitcode(status) if hasattr(os, "waitstatus_to_exitcode") else 0
+
+    if expired:
+        return seconds, usage.ru_maxrss, "timeout"
+    if os.WIFSIGNALED(status):
+        return seconds, usage.ru_maxrss, "signal %d" % os.WTERMSIG(status)
+    if os.WEXITSTATUS(status) != 0:
+        return seconds, usage.ru_maxrss, "exit %d" % os.WEXITSTATUS(status)
+    return seconds, usage.ru_maxrss, "ok"
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Scaling benchmark of the CSE 231 passes.")
+    parser.add_argument("--plugin", action="append", default=[], metavar="PASS=SO",
+                        help="shared object providing a pass, e.g. cse231-liveness=liveness.so")
+    parser.add_argument("--opt", default="opt", help="opt binary to load the plugins into")
+    parser.add_argument("--shapes", default=",".join(sorted(gen_ir.SHAPES)),
+                        help="comma separated shapes, see gen_ir.py")
+    parser.add_argument("--sizes", default="100,300,1000,3000", help="comma separated sizes")
+    parser.add_argument("--depth", type=int, default=2)
+    parser.add_argument("--width", type=int, default=8)
+    parser.add_argument("--density", type=float, default=0.5)
+    parser.add_argument("--functions", type=int, default=1)
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--repeat", type=int, default=1,
+                        help="runs per point; the fastest time and the largest RSS are kept")
+    parser.add_argument("--timeout", type=float, default=600, help="seconds before a run is killed")
+    parser.add_argument("--pass-args", default="", help="extra arguments for opt, e.g. -liveness-wto")
+    parser.add_argument("--output", help="CSV file to write instead of stdout")
+    args = parser.parse_args()
+
+    plugins = {}
+    for spec in args.plugin:
+        name, _, path = spec.partition("=")
+        if not path:
+            parser.error("--plugin expects PASS=SO, got %r" % spec)
+        plugins[name] = os.path.abspath(path)
+    if not plugins:
+        parser.error("no --plugin given")
+
+    passes = [p for p in PASSES if p in plugins] + sorted(p for p in plugins if p not in PASSES)
+    shapes = args.shapes.split(",")
+    sizes = [int(s) for s in args.sizes.split(",")]
+    base = [args.opt] + legacy_pm_flags(args.opt) + args.pass_args.split()
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.DictWriter(out, fieldnames=FIELDS, lineterminator="\n")
+    writer.writeheader()
+
+    with tempfile.TemporaryDirectory() as tmp:
+        for shape in shapes:
+            for size in sizes:
+                text = gen_ir.generate(shape, size, args.depth, args.width, args.density,
+                                       args.functions, args.seed)
+                header = dict(item.split("=") for item in text.splitlines()[0][2:].split())
+                module = os.path.join(tmp, "%s-%d.ll" % (shape, size))
+                with open(module, "w") as f:
+                    f.write(text)
+
+                for name in passes:
+                    command = base + ["-load", plugins[name], "-" + name, "-disable-output", module]
+                    best, rss, status = None, 0, "ok"
+                    for _ in range(args.repeat):
+                        seconds, peak, status = run_once(command, args.timeout)
+                        best = seconds if best is None else min(best, seconds)
+                        rss = max(rss, peak)
+                        if status != "ok":
+                            break
+
+                    writer.writerow({
+                        "pass": name, "shape": shape, "size": size,
+                        "depth": args.depth, "width": args.width, "density": args.density,
+                        "functions": args.functions,
+                        "blocks": header["blocks"], "instructions": header["instructions"],
+                        "seconds": "%.3f" % best, "peak_rss_kb": rss, "status": status,
+                    })
+                    out.flush()
+                    print("%s %s %d: %.3fs %d KB %s" % (name, shape, size, best, rss, status), file=sys.stderr)
+
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
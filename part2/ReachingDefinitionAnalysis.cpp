@@ -7,6 +7,8 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <deque>
@@ -18,55 +20,67 @@
 using namespace llvm;
 using namespace std;
 
-
-class ReachingInfo : public Info {
-
-
-public:
-   vector<unsigned> v_info;
-
-   void print() {
-      for(unsigned v : v_info) {
-         errs() << v << "|";
-      }
-      errs() << "\n";
-   }
-
-   void addInfo(unsigned i) {
-      v_info.push_back(i);
-      sort(v_info.begin(), v_info.end());
-      v_info.erase(std::unique(v_info.begin(), v_info.end()), v_info.end());
-   }
-
-   static bool equals(ReachingInfo *info1, ReachingInfo *info2) {
-      //errs() << info1->v_info.size() << " " << info2->v_info.size() << "\n";
-      return info1->v_info == info2->v_info;
-   }
-
-
-   static ReachingInfo* join(ReachingInfo *info1, ReachingInfo *info2, ReachingInfo *result) {
-    
-      if(result == NULL || info1 == NULL || info2 == NULL) return NULL;
-
-      result->v_info.reserve(info1->v_info.size() + info2->v_info.size());
-      result->v_info.insert(result->v_info.end(), info1->v_info.begin(), info1->v_info.end());
-      result->v_info.insert(result->v_info.end(), info2->v_info.begin(), info2->v_info.end());
-
-      sort(result->v_info.begin(), result->v_info.end());
-      result->v_info.erase(std::unique(result->v_info.begin(), result->v_info.end()), result->v_info.end());
-      return result;
-   }   
-
-};
+static cl::opt<bool> BlockSummary("reaching-block-summary",
+                                  cl::desc("Iterate cse231-reaching over basic block summaries"),
+                                  cl::init(false));
+static cl::opt<bool> WeakTopological("reaching-wto",
+                                     cl::desc("Iterate cse231-reaching in weak topological order"),
+                                     cl::init(false));
+static cl::opt<bool> Delta("reaching-delta",
+                           cl::desc("Propagate only newly added cse231-reaching facts"),
+                           cl::init(false));
+static cl::opt<bool> Intern("reaching-intern",
+                            cl::desc("Keep one shared copy of each distinct cse231-reaching value"),
+                            cl::init(false));
+static cl::opt<bool> Boundary("reaching-boundary",
+                              cl::desc("Keep cse231-reaching facts only between basic blocks and replay blocks to print them"),
+                              cl::init(false));
+static cl::opt<unsigned> Threads("reaching-threads",
+                                 cl::desc("Worker threads for cse231-reaching-module (0: one per hardware thread)"),
+                                 cl::init(0));
+static cl::list<unsigned> QueryPoints("reaching-query",
+                                     cl::desc("Print only the edges leaving these instructions, solving just what they depend on"),
+                                     cl::value_desc("index"),
+                                     cl::CommaSeparated);
+static cl::opt<std::string> OutputFile("reaching-output",
+                                       cl::desc("Write the cse231-reaching results to this file instead of stderr"),
+                                       cl::value_desc("filename"),
+                                       cl::init(""));
+static cl::opt<bool> BinaryOutput("reaching-binary",
+                                  cl::desc("Write the cse231-reaching results in the compact binary format read by tools/DecodeResults.cpp"),
+                                  cl::init(false));
+static cl::opt<std::string> CacheDir("reaching-cache-dir",
+                                     cl::desc("Reuse the cse231-reaching results of unchanged functions kept in this directory"),
+                                     cl::value_desc("directory"),
+                                     cl::init(""));
+static cl::opt<unsigned> CacheSize("reaching-cache-size",
+                                   cl::desc("Size limit of -reaching-cache-dir in MB, least recently used results go first (0: no limit)"),
+                                   cl::init(256));
+static cl::opt<std::string> StatsFile("reaching-stats",
+                                     cl::desc("Append per-function cse231-reaching statistics to this file as JSON lines"),
+                                     cl::value_desc("filename"),
+                                     cl::init(""));
+
+
+/*
+ * Sets of instruction indices, kept as a bit vector over the framework's index space.
+ */
+typedef BitVectorInfo ReachingInfo;
 
 
 template <class Info, bool Direction>
-class ReachingAnalysis : public DataFlowAnalysis<Info, Direction> {
+class ReachingAnalysis : public DataFlowAnalysis<Info, Direction, ReachingAnalysis<Info, Direction> > {
+
+   typedef DataFlowAnalysis<Info, Direction, ReachingAnalysis<Info, Direction> > Base;
+   friend Base;
 
    private:
 
+      // Definitions made by each block, see blockflowfunction()
+      DenseMap<BasicBlock *, Info> BlockGen;
+
       void initializeForwardMap(Function * func) {
-         DataFlowAnalysis<Info, Direction>::initializeForwardMap(func);
+         Base::initializeForwardMap(func);
       }
 
       void initializeBackwardMap(Function * func) {
@@ -104,15 +118,18 @@ class ReachingAnalysis : public DataFlowAnalysis<Info, Direction> {
          //errs() << "stuck in flowlimbo~~~~\n";
          if(I == NULL) return;
 
-         Info *newInfo = new Info();
-
          unsigned index = this->getInstrToIndex(I);
-         for(auto i : IncomingEdges) {
-            ReachingInfo * oldInfo = this->getEdgeToInfo(make_pair(i, index));
-            ReachingInfo::join(newInfo, oldInfo, newInfo);
+         unsigned instrType = getInstrType(I);
+
+         // Only definitions change the incoming value; everything else passes it on.
+         Info *in = this->joinIncoming(index, IncomingEdges);
+         Info *newInfo = in;
+         if(instrType == 1 || instrType == 3) {
+            newInfo = this->allocateInfo();
+            *newInfo = *in;
+            this->discardInfo(in);
          }
 
-         unsigned instrType = getInstrType(I);
          switch(instrType) {
             case 1:  newInfo->addInfo(index); break;
             case 3:  
@@ -132,31 +149,173 @@ class ReachingAnalysis : public DataFlowAnalysis<Info, Direction> {
          //errs() << "yay... out of flowlimbo...\n";
       } // end flowfunction
 
+      /*
+       * Nothing is killed and the definitions were added on the first visit,
+       * so only the new facts need to be passed on.
+       */
+      bool deltaflowfunction(Instruction * I,
+                             Info * In,
+                             Info * Delta,
+                             std::vector<unsigned> & OutgoingEdges,
+                             std::vector<Info *> & Infos) {
+
+         Info *newInfo = this->allocateInfo();
+         *newInfo = *Delta;
+         for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
+            Infos.push_back(newInfo);
+         }
+         return true;
+      } // end deltaflowfunction
+
+      /*
+       * Nothing is killed, so a block adds every definition it makes (all of its phis
+       * and the instructions of type 1) to whatever reaches it.
+       */
+      bool blockflowfunction(BasicBlock * BB,
+                             Info * In,
+                             std::vector<unsigned> & OutgoingEdges,
+                             std::vector<Info *> & Infos) {
+
+         auto it = BlockGen.find(BB);
+         if(it == BlockGen.end()) {
+            Info gen;
+            for(Instruction &instr : *BB) {
+               unsigned instrType = getInstrType(&instr);
+               if(instrType == 1 || instrType == 3)
+                  gen.addInfo(this->getInstrToIndex(&instr));
+            }
+            it = BlockGen.insert(make_pair(BB, gen)).first;
+         }
+
+         Info *newInfo = this->allocateInfo();
+         ReachingInfo::join(In, &it->second, newInfo);
+         for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
+            Infos.push_back(newInfo);
+         }
+         return true;
+      } // end blockflowfunction
+
    public:
-      ReachingAnalysis(Info &bottom, Info &initState) : DataFlowAnalysis<Info, Direction>(bottom, initState) {}
+      ReachingAnalysis(Info &bottom, Info &initState) : Base(bottom, initState) {}
 
 };
 
 
 namespace {
+   /*
+    * Run the analysis on F and print its results to OS.
+    */
+   void analyzeFunction(Function &F, raw_ostream &OS) {
+      ReachingInfo bott;
+      ReachingInfo init;
+      ReachingAnalysis<ReachingInfo, true> analysis(bott, init);
+      analysis.setBlockSummaryMode(BlockSummary);
+      analysis.setWeakTopologicalOrder(WeakTopological);
+      analysis.setDeltaMode(Delta);
+      analysis.setInterning(Intern);
+      analysis.setBoundaryMode(Boundary);
+      analysis.setCollectStats(!StatsFile.empty());
+
+      ResultCache cache(CacheDir, "cse231-reaching");
+      std::string key = cache.getKey(F);
+      std::string data;
+      bool cached = cache.lookup(key, data) && analysis.readResults(&F, data);
+
+      if (QueryPoints.empty()) {
+         if (!cached) {
+            analysis.runWorklistAlgorithm(&F);
+            if (cache.isEnabled())
+               cache.store(key, analysis.writeResults());
+         }
+         if (BinaryOutput)
+            analysis.printBinary(OS);
+         else
+            analysis.print(OS);
+      }
+      else {
+         if (!cached)
+            analysis.prepareQueries(&F);
+         if (BinaryOutput) {
+            std::vector<unsigned> points(QueryPoints.begin(), QueryPoints.end());
+            analysis.printBinary(OS, &points);
+         }
+         else {
+            for (unsigned index : QueryPoints)
+               analysis.printQuery(index, OS);
+         }
+      }
+
+      if (!StatsFile.empty())
+         appendStatsLine(StatsFile, "cse231-reaching", analysis.getStats());
+   }
+
+   /*
+    * Open Results where the command line asks. Returns false, after reporting why on stderr,
+    * if the file cannot be created; the pass then analyzes nothing.
+    */
+   bool openResults(ResultStream &Results) {
+      if (std::error_code error = Results.open(OutputFile, BinaryOutput, "cse231-reaching")) {
+         errs() << "error: cannot write cse231-reaching results to " << OutputFile << ": " << error.message() << "\n";
+         return false;
+      }
+      return true;
+   }
+
    struct ReachingDefinitionAnalysisPass : public FunctionPass {
       public:
          static char ID;
          ReachingDefinitionAnalysisPass() : FunctionPass(ID) {}
+
+         bool doInitialization(Module &M) override {
+            openResults(Results);
+            return false;
+         }
+
          bool runOnFunction(Function &F) override { 
-            ReachingInfo *bott = new ReachingInfo();
-            ReachingInfo *init = new ReachingInfo();
-            ReachingAnalysis<ReachingInfo, true> analysis(*bott, *init);
+            if (!Results.isOpen())
+               return false;
+            analyzeFunction(F, Results.stream());
+            Results.flush();
+            return false;
+         }
 
-            analysis.runWorklistAlgorithm(&F);
-            analysis.print();
+         bool doFinalization(Module &M) override {
+            Results.close();
+            ResultCache(CacheDir, "cse231-reaching").prune((uint64_t)CacheSize << 20);
             return false;
          }
+
+      private:
+         ResultStream Results;
    }; 
+
+   /*
+    * Analyzes all functions of the module concurrently, printing them in module order.
+    */
+   struct ReachingDefinitionModulePass : public ModulePass {
+      public:
+         static char ID;
+         ReachingDefinitionModulePass() : ModulePass(ID) {}
+         bool runOnModule(Module &M) override {
+            ResultStream results;
+            if (!openResults(results))
+               return false;
+            runOnFunctionsInParallel(M, Threads, results.stream(), analyzeFunction);
+            results.close();
+            ResultCache(CacheDir, "cse231-reaching").prune((uint64_t)CacheSize << 20);
+            return false;
+         }
+   };
 }
 
 char ReachingDefinitionAnalysisPass::ID = 0;
 static RegisterPass<ReachingDefinitionAnalysisPass> X("cse231-reaching",
                                                       "Developed to test LLVM and docker",
                                                       false /* Only looks at CFG */,
-                                                      false /* Analysis Pass */);
\ No newline at end of file
+                                                      false /* Analysis Pass */);
+
+char ReachingDefinitionModulePass::ID = 0;
+static RegisterPass<ReachingDefinitionModulePass> Y("cse231-reaching-module",
+                                                    "Runs cse231-reaching on all functions in parallel",
+                                                    false /* Only looks at CFG */,
+                                                    false /* Analysis Pass */);
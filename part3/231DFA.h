@@ -14,17 +14,48 @@
 #ifndef LLVM_TRANSFORMS_231DFA_H
 #define LLVM_TRANSFORMS_231DFA_H
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/InitializePasses.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 namespace llvm {
 
 
@@ -46,6 +77,12 @@ class Info {
      */
     virtual void print() = 0;
 
+    /*
+     * Print out the information to OS, in the same format print() writes to errs().
+     * The framework uses this to buffer the output of one function at a time.
+     */
+    virtual void print(raw_ostream & OS) = 0;
+
     /*
      * Compare two pieces of information
      *
@@ -63,27 +100,751 @@ class Info {
     static Info* join(Info * info1, Info * info2, Info * result);
 };
 
+/*
+ * Read the ULEB128 number at Ptr into Value and move Ptr past it. Returns false if the
+ * number does not end before End. Used to decode the results kept by ResultCache.
+ */
+inline bool readULEB128(const uint8_t *& Ptr, const uint8_t * End, uint64_t & Value) {
+   unsigned length = 0;
+   const char * error = nullptr;
+   Value = decodeULEB128(Ptr, &length, End, &error);
+   if (error != nullptr)
+      return false;
+   Ptr += length;
+   return true;
+}
+
+/*
+ * A set of instruction indices stored as a packed bit vector.
+ * This is the lattice used by analyses whose facts are sets over the dense index space
+ * assigned by DataFlowAnalysis (reaching definitions, liveness): join is union and the
+ * order is set inclusion. The word kernels use AVX2 or SSE2 when the compiler targets them.
+ *
+ * The vector grows on demand; missing words are zero, so two sets are equal even if one
+ * of them carries extra all-zero words.
+ */
+class BitVectorInfo : public Info {
+
+  private:
+      static const unsigned WordBits = 64;
+
+      static void orWords(uint64_t * dst, const uint64_t * src, size_t n) {
+         size_t i = 0;
+#if defined(__AVX2__)
+         for (; i + 4 <= n; i += 4) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, s));
+         }
+#elif defined(__SSE2__)
+         for (; i + 2 <= n; i += 2) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(d, s));
+         }
+#endif
+         for (; i < n; i++)
+            dst[i] |= src[i];
+      }
+
+      static void andNotWords(uint64_t * dst, const uint64_t * src, size_t n) {
+         size_t i = 0;
+#if defined(__AVX2__)
+         for (; i + 4 <= n; i += 4) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_andnot_si256(s, d));
+         }
+#elif defined(__SSE2__)
+         for (; i + 2 <= n; i += 2) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_andnot_si128(s, d));
+         }
+#endif
+         for (; i < n; i++)
+            dst[i] &= ~src[i];
+      }
+
+      static bool equalWords(const uint64_t * a, const uint64_t * b, size_t n) {
+         size_t i = 0;
+#if defined(__AVX2__)
+         for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                         _mm256_loadu_si256((const __m256i *)(b + i)));
+            if (!_mm256_testz_si256(x, x))
+               return false;
+         }
+#elif defined(__SSE2__)
+         for (; i + 2 <= n; i += 2) {
+            __m128i x = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                                       _mm_loadu_si128((const __m128i *)(b + i)));
+            if (_mm_movemask_epi8(x) != 0xFFFF)
+               return false;
+         }
+#endif
+         for (; i < n; i++) {
+            if (a[i] != b[i])
+               return false;
+         }
+         return true;
+      }
+
+      static bool zeroWords(const uint64_t * a, size_t n) {
+         for (size_t i = 0; i < n; i++) {
+            if (a[i] != 0)
+               return false;
+         }
+         return true;
+      }
+
+  public:
+      std::vector<uint64_t> Words;
+
+      void print() {
+         print(errs());
+      }
+
+      void print(raw_ostream & OS) {
+         for (size_t w = 0; w < Words.size(); w++) {
+            uint64_t word = Words[w];
+            while (word != 0) {
+               OS << (unsigned)(w * WordBits + countTrailingZeros(word)) << "|";
+               word &= word - 1;
+            }
+         }
+         OS << "\n";
+      }
+
+      void addInfo(unsigned i) {
+         if (i / WordBits >= Words.size())
+            Words.resize(i / WordBits + 1, 0);
+         Words[i / WordBits] |= (uint64_t)1 << (i % WordBits);
+      }
+
+      void removeInfo(unsigned i) {
+         if (i / WordBits < Words.size())
+            Words[i / WordBits] &= ~((uint64_t)1 << (i % WordBits));
+      }
+
+      bool hasInfo(unsigned i) const {
+         return i / WordBits < Words.size() && ((Words[i / WordBits] >> (i % WordBits)) & 1);
+      }
+
+      bool isEmpty() const {
+         return zeroWords(Words.data(), Words.size());
+      }
+
+      /*
+       * Ignores trailing zero words, like equals().
+       */
+      static unsigned hash(BitVectorInfo * info) {
+         size_t size = info->Words.size();
+         while (size > 0 && info->Words[size - 1] == 0)
+            size--;
+         return hash_combine_range(info->Words.begin(), info->Words.begin() + size);
+      }
+
+      /*
+       * Number of elements in the set.
+       */
+      unsigned count() const {
+         unsigned n = 0;
+         for (uint64_t word : Words)
+            n += countPopulation(word);
+         return n;
+      }
+
+      static bool equals(BitVectorInfo * info1, BitVectorInfo * info2) {
+         const std::vector<uint64_t> &lhs = info1->Words;
+         const std::vector<uint64_t> &rhs = info2->Words;
+         size_t common = std::min(lhs.size(), rhs.size());
+
+         if (!equalWords(lhs.data(), rhs.data(), common))
+            return false;
+         if (lhs.size() > common)
+            return zeroWords(lhs.data() + common, lhs.size() - common);
+         return zeroWords(rhs.data() + common, rhs.size() - common);
+      }
+
+      /*
+       * result = info1 U info2. result may alias either operand.
+       */
+      static BitVectorInfo * join(BitVectorInfo * info1, BitVectorInfo * info2, BitVectorInfo * result) {
+         if (result == NULL || info1 == NULL || info2 == NULL) return NULL;
+
+         if (result == info2)
+            std::swap(info1, info2);
+         if (result != info1)
+            result->Words = info1->Words;
+         if (result->Words.size() < info2->Words.size())
+            result->Words.resize(info2->Words.size(), 0);
+
+         orWords(result->Words.data(), info2->Words.data(), info2->Words.size());
+         return result;
+      }
+
+      /*
+       * result = info1 - info2. result may alias info1.
+       */
+      static BitVectorInfo * subtract(BitVectorInfo * info1, BitVectorInfo * info2, BitVectorInfo * result) {
+         if (result == NULL || info1 == NULL || info2 == NULL) return NULL;
+
+         if (result != info1)
+            result->Words = info1->Words;
+         if (result == info2) {
+            result->Words.assign(result->Words.size(), 0);
+            return result;
+         }
+
+         andNotWords(result->Words.data(), info2->Words.data(),
+                     std::min(result->Words.size(), info2->Words.size()));
+         return result;
+      }
+
+      /*
+       * result = { newIndex[i] : i in info }, dropping the i mapped to ~0U. result must not
+       * alias info.
+       */
+      static BitVectorInfo * renumber(BitVectorInfo * info, const std::vector<unsigned> & newIndex,
+                                      BitVectorInfo * result) {
+         result->Words.clear();
+         for (size_t w = 0; w < info->Words.size(); w++) {
+            for (uint64_t word = info->Words[w]; word != 0; word &= word - 1) {
+               unsigned i = w * WordBits + countTrailingZeros(word);
+               if (i < newIndex.size() && newIndex[i] != ~0U)
+                  result->addInfo(newIndex[i]);
+            }
+         }
+         return result;
+      }
+
+      /*
+       * Append info to Out for ResultCache: the number of elements, then the gaps between
+       * consecutive ones, as ULEB128.
+       */
+      static void serialize(BitVectorInfo * info, raw_ostream & Out) {
+         encodeULEB128(info->count(), Out);
+         unsigned last = 0;
+         for (size_t w = 0; w < info->Words.size(); w++) {
+            for (uint64_t word = info->Words[w]; word != 0; word &= word - 1) {
+               unsigned i = w * WordBits + countTrailingZeros(word);
+               encodeULEB128(i - last, Out);
+               last = i;
+            }
+         }
+      }
+
+      /*
+       * Read a value written by serialize() at Ptr into result, which must be empty, and
+       * move Ptr past it. Returns false if the data is cut short or holds an element that
+       * is not below Limit.
+       */
+      static bool deserialize(const uint8_t *& Ptr, const uint8_t * End, unsigned Limit,
+                              BitVectorInfo * result) {
+         uint64_t count, i = 0;
+         if (!readULEB128(Ptr, End, count) || count > Limit)
+            return false;
+         for (uint64_t k = 0; k < count; k++) {
+            uint64_t gap;
+            if (!readULEB128(Ptr, End, gap) || gap >= Limit - i)
+               return false;
+            i += gap;
+            result->addInfo(i);
+         }
+         return true;
+      }
+};
+
+/*
+ * Worklist of items 0 .. N-1 that always pops the item with the lowest rank.
+ * An item is held at most once; pushing an item that is already queued is a no-op.
+ */
+class OrderedWorklist {
+
+  private:
+      typedef std::pair<unsigned, unsigned> Entry; // (rank, item)
+
+      std::vector<unsigned> Rank;
+      BitVector Queued;
+      std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > Heap;
+
+  public:
+      void init(const std::vector<unsigned> & rank) {
+         Rank = rank;
+         Queued.clear();
+         Queued.resize(Rank.size());
+         Heap = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> >();
+      }
+
+      /*
+       * Returns false if item was already queued.
+       */
+      bool push(unsigned item) {
+         if (Queued.test(item))
+            return false;
+         Queued.set(item);
+         Heap.push(std::make_pair(Rank[item], item));
+         return true;
+      }
+
+      unsigned pop() {
+         unsigned item = Heap.top().second;
+         Heap.pop();
+         Queued.reset(item);
+         return item;
+      }
+
+      bool empty() const {
+         return Heap.empty();
+      }
+
+      unsigned size() const {
+         return Heap.size();
+      }
+};
+
+/*
+ * Pool of lattice values owned by one DataFlowAnalysis.
+ *
+ * Values are carved out of a std::deque so their addresses stay stable, and every value
+ * carries a count of the edges that currently hold it. A value whose count drops to zero is
+ * cleared and put on a free list for the next allocate(), so memory tracks the number of
+ * distinct live values rather than the number of flow function calls.
+ * Pointers not handed out by this pool (e.g. Bottom, InitialState) are ignored.
+ *
+ * Values can also be hash-consed with intern(): each distinct interned value exists once,
+ * so two interned values are equal exactly if they are the same pointer. Interned values
+ * must not be modified. intern() and join() need a static Info::hash(Info *) that agrees
+ * with Info::equals.
+ */
+template <class Info>
+class InfoPool {
+
+  private:
+      // Marks a value that is sitting on the free list
+      static const unsigned Free = ~0U;
+
+      struct Entry {
+         // Number of edges holding the value, or Free
+         unsigned Refs;
+         // Nonzero once the value is interned; never reused, unlike the address
+         uint64_t Id;
+         unsigned Hash;
+      };
+
+      std::deque<Info> Storage;
+      std::vector<Info *> FreeList;
+      DenseMap<Info *, Entry> Entries;
+      // Interned values by hash
+      DenseMap<unsigned, std::vector<Info *> > Interned;
+      uint64_t NextId = 1;
+      // Interned joins: (Id, Id) -> (result, result Id). A result that was recycled since
+      // shows up as an Id mismatch.
+      DenseMap<std::pair<uint64_t, uint64_t>, std::pair<Info *, uint64_t> > Joins;
+
+      void recycle(Info * info, Entry & entry) {
+         if (entry.Id != 0) {
+            std::vector<Info *> &bucket = Interned[entry.Hash];
+            bucket.erase(std::find(bucket.begin(), bucket.end(), info));
+            entry.Id = 0;
+         }
+         *info = Info();
+         entry.Refs = Free;
+         FreeList.push_back(info);
+      }
+
+  public:
+      Info * allocate() {
+         Info * info;
+         if (!FreeList.empty()) {
+            info = FreeList.back();
+            FreeList.pop_back();
+         }
+         else {
+            Storage.emplace_back();
+            info = &Storage.back();
+         }
+         Entry &entry = Entries[info];
+         entry.Refs = 0;
+         entry.Id = 0;
+         return info;
+      }
+
+      void retain(Info * info) {
+         auto it = Entries.find(info);
+         if (it != Entries.end())
+            it->second.Refs++;
+      }
+
+      void release(Info * info) {
+         auto it = Entries.find(info);
+         if (it != Entries.end() && it->second.Refs != Free && --it->second.Refs == 0)
+            recycle(info, it->second);
+      }
+
+      /*
+       * Recycle info if no edge holds it. Used for values returned by a flow function
+       * that did not replace any edge value.
+       */
+      void releaseIfUnused(Info * info) {
+         auto it = Entries.find(info);
+         if (it != Entries.end() && it->second.Refs == 0)
+            recycle(info, it->second);
+      }
+
+      /*
+       * Whether info is a pool value held by exactly one edge, so it may be changed in place.
+       */
+      bool isExclusive(Info * info) const {
+         auto it = Entries.find(info);
+         return it != Entries.end() && it->second.Refs == 1 && it->second.Id == 0;
+      }
+
+      bool isInterned(Info * info) const {
+         auto it = Entries.find(info);
+         return it != Entries.end() && it->second.Id != 0;
+      }
+
+      /*
+       * The interned value equal to info. If there is none yet, info becomes it; values
+       * not from this pool are copied in first. An unused info that has an equal interned
+       * value is left to the caller to release.
+       */
+      Info * intern(Info * info) {
+         auto it = Entries.find(info);
+         if (it != Entries.end() && it->second.Id != 0)
+            return info;
+
+         unsigned hash = Info::hash(info);
+         std::vector<Info *> &bucket = Interned[hash];
+         for (Info * other : bucket) {
+            if (Info::equals(other, info))
+               return other;
+         }
+
+         if (it == Entries.end()) {
+            Info * copy = allocate();
+            *copy = *info;
+            info = copy;
+            it = Entries.find(info);
+         }
+         it->second.Id = NextId++;
+         it->second.Hash = hash;
+         bucket.push_back(info);
+         return info;
+      }
+
+      /*
+       * The interned join of two interned values, memoized by the pair.
+       */
+      Info * join(Info * info1, Info * info2) {
+         if (info1 == info2)
+            return info1;
+
+         uint64_t id1 = Entries.find(info1)->second.Id;
+         uint64_t id2 = Entries.find(info2)->second.Id;
+         std::pair<uint64_t, uint64_t> key = std::make_pair(std::min(id1, id2), std::max(id1, id2));
+         auto memo = Joins.find(key);
+         if (memo != Joins.end()) {
+            auto it = Entries.find(memo->second.first);
+            if (it != Entries.end() && it->second.Id == memo->second.second)
+               return memo->second.first;
+         }
+
+         Info * result = allocate();
+         Info::join(info1, info2, result);
+         Info * canonical = intern(result);
+         if (canonical != result)
+            releaseIfUnused(result);
+         Joins[key] = std::make_pair(canonical, Entries.find(canonical)->second.Id);
+         return canonical;
+      }
+
+      /*
+       * Recycle every value no edge holds and give the free list's capacity back.
+       */
+      void trim() {
+         for (auto &it : Entries) {
+            if (it.second.Refs == 0)
+               recycle(it.first, it.second);
+         }
+         std::vector<Info *>(FreeList).swap(FreeList);
+         Joins.clear();
+      }
+
+      void reset() {
+         Entries.clear();
+         FreeList.clear();
+         Storage.clear();
+         Interned.clear();
+         Joins.clear();
+      }
+};
+
+/*
+ * What one runWorklistAlgorithm() did, see DataFlowAnalysis::getStats().
+ * The counters are always kept; Iterations and the phase times are only filled in when
+ * collection is enabled with setCollectStats(), since they cost a clock read or a table update.
+ */
+struct DataFlowStats {
+   std::string Function;
+   unsigned Instructions = 0;
+   unsigned Edges = 0;
+
+   // Nodes (or blocks, in block summary mode) taken off the worklist
+   unsigned NodeVisits = 0;
+   unsigned FlowFunctionCalls = 0;
+   unsigned BlockFlowFunctionCalls = 0;
+   // Incoming facts merged, either by the flow functions or by the framework
+   unsigned Joins = 0;
+   // Checks made to decide whether an edge changed (Info::equals, or in delta mode
+   // emptiness of the new facts), and edges that did
+   unsigned EqualityChecks = 0;
+   unsigned EdgeUpdates = 0;
+   unsigned SuppressedPushes = 0;
+   unsigned WorklistPeak = 0;
+   // Largest number of visits made to a single node before the fixpoint was reached
+   unsigned Iterations = 0;
+   // The results were read from a ResultCache instead of being computed
+   bool CacheHit = false;
+
+   // Wall time of each phase in seconds
+   double IndexTime = 0;
+   double EdgeInitTime = 0;
+   double SolveTime = 0;
+   double PrintTime = 0;
+
+   /*
+    * Write the stats as one JSON object on a single line.
+    */
+   void printJSON(raw_ostream & OS, StringRef Analysis) const {
+      OS << "{\"analysis\":";
+      printString(OS, Analysis);
+      OS << ",\"function\":";
+      printString(OS, Function);
+      OS << ",\"instructions\":" << Instructions
+         << ",\"edges\":" << Edges
+         << ",\"node_visits\":" << NodeVisits
+         << ",\"flowfunction_calls\":" << FlowFunctionCalls
+         << ",\"blockflowfunction_calls\":" << BlockFlowFunctionCalls
+         << ",\"joins\":" << Joins
+         << ",\"equality_checks\":" << EqualityChecks
+         << ",\"edge_updates\":" << EdgeUpdates
+         << ",\"suppressed_pushes\":" << SuppressedPushes
+         << ",\"worklist_peak\":" << WorklistPeak
+         << ",\"iterations\":" << Iterations
+         << ",\"cache_hit\":" << (CacheHit ? "true" : "false")
+         << ",\"index_seconds\":" << format("%.9f", IndexTime)
+         << ",\"edge_init_seconds\":" << format("%.9f", EdgeInitTime)
+         << ",\"solve_seconds\":" << format("%.9f", SolveTime)
+         << ",\"print_seconds\":" << format("%.9f", PrintTime)
+         << "}\n";
+   }
+
+  private:
+   static void printString(raw_ostream & OS, StringRef S) {
+      OS << '"';
+      for (char c : S) {
+         if (c == '"' || c == '\\')
+            OS << '\\' << c;
+         else if (static_cast<unsigned char>(c) < 0x20)
+            OS << format("\\u%04x", c);
+         else
+            OS << c;
+      }
+      OS << '"';
+   }
+};
+
+/*
+ * Adds the wall time between construction and destruction to *Seconds, if Seconds is set.
+ */
+class PhaseTimer {
+
+  private:
+      double * Seconds;
+      std::chrono::steady_clock::time_point Start;
+
+  public:
+      explicit PhaseTimer(double * seconds) : Seconds(seconds) {
+         if (Seconds)
+            Start = std::chrono::steady_clock::now();
+      }
+
+      ~PhaseTimer() {
+         if (Seconds)
+            *Seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+      }
+};
+
+/*
+ * Writes the values of a sequence of edges for ResultCache and ResultStream. Every edge gets
+ * the number of its value in ULEB128. A value not seen before takes the next number and
+ * follows it right away, as what it adds to and drops from the previous new value, since
+ * neighbouring values tend to be close. Values are told apart by address, so one that may
+ * be freed and its address reused must be forgotten once written. Info must provide static
+ * subtract() and serialize(Info *, raw_ostream &).
+ */
+template <class Info>
+class EdgeValueWriter {
+      raw_ostream & OS;
+      DenseMap<Info *, unsigned> Numbers;
+      unsigned Count = 0;
+      Info Previous;
+
+   public:
+      explicit EdgeValueWriter(raw_ostream & OS) : OS(OS) {}
+
+      void write(Info * value) {
+         auto inserted = Numbers.insert(std::make_pair(value, Count));
+         encodeULEB128(inserted.first->second, OS);
+         if (!inserted.second)
+            return;
+
+         Count++;
+         Info added, dropped;
+         Info::subtract(value, &Previous, &added);
+         Info::subtract(&Previous, value, &dropped);
+         Info::serialize(&added, OS);
+         Info::serialize(&dropped, OS);
+         Previous = *value;
+      }
+
+      void forget(Info * value) {
+         Numbers.erase(value);
+      }
+};
+
+/*
+ * Read what an EdgeValueWriter wrote for NumEdges edges at Ptr and move Ptr past it.
+ * Allocate() returns an empty Info to hold each value; Values gets them and EdgeValues
+ * the value of every edge. Info must provide a static deserialize(Ptr, End, Limit,
+ * Info * result) that reads what serialize() wrote, with ids below Limit. Returns false
+ * if the data does not decode.
+ */
+template <class Info, class Allocator>
+bool readEdgeValues(const uint8_t *& Ptr, const uint8_t * End, unsigned Limit, uint64_t NumEdges,
+                    Allocator Allocate, std::vector<Info *> & Values, std::vector<Info *> & EdgeValues) {
+   Values.clear();
+   EdgeValues.resize(NumEdges);
+   for (uint64_t e = 0; e < NumEdges; e++) {
+      uint64_t value;
+      if (!readULEB128(Ptr, End, value) || value > Values.size())
+         return false;
+
+      if (value == Values.size()) {
+         Info added, dropped;
+         if (!Info::deserialize(Ptr, End, Limit, &added) || !Info::deserialize(Ptr, End, Limit, &dropped))
+            return false;
+
+         Info * fresh = Allocate();
+         if (!Values.empty())
+            Info::subtract(Values.back(), &dropped, fresh);
+         Info::join(fresh, &added, fresh);
+         Values.push_back(fresh);
+      }
+      EdgeValues[e] = Values[value];
+   }
+   return true;
+}
+
 /*
  * This is the base template class to represent the generic dataflow analysis framework
  * For a specific analysis, you need to create a sublcass of it.
+ *
+ * If the subclass passes itself as Analysis, its flowfunction and blockflowfunction are
+ * called directly and can be inlined into the solver loops; the subclass then has to make
+ * DataFlowAnalysis<Info, Direction, Subclass> a friend if those functions are private.
+ * With the default (void) they are called through the virtual functions below.
  */
-template <class Info, bool Direction>
+template <class Info, bool Direction, class Analysis = void>
 class DataFlowAnalysis {
 
   private:
       typedef std::pair<unsigned, unsigned> Edge;
-      // Index to instruction map
-      std::map<unsigned, Instruction *> IndexToInstr;
+      // std::true_type if flow functions are reached through virtual calls
+      typedef std::integral_constant<bool, std::is_void<Analysis>::value> DynamicDispatch;
+      // Index to instruction table
+      std::vector<Instruction *> IndexToInstr;
       // Instruction to index map
-      std::map<Instruction *, unsigned> InstrToIndex;
-      // Edge to information map
-      std::map<Edge, Info *> EdgeToInfo;
+      DenseMap<Instruction *, unsigned> InstrToIndex;
+      // Edges recorded by addEdge() while the maps are being initialized
+      std::vector<std::pair<Edge, Info *> > PendingEdges;
+      // Edge id to information table.
+      // Edge ids are dense and assigned in (src, dst) order by buildAdjacency().
+      std::vector<Info *> EdgeToInfo;
+      // Source instruction index of each edge id
+      std::vector<unsigned> EdgeSrc;
+      // Compressed predecessor/successor adjacency, see buildAdjacency()
+      std::vector<unsigned> PredOffsets;
+      std::vector<unsigned> PredList;
+      std::vector<unsigned> PredEdges;
+      std::vector<unsigned> SuccOffsets;
+      std::vector<unsigned> SuccList;
       // The bottom of the lattice
       Info Bottom;
       // The initial state of the analysis
       Info InitialState;
       // EntryInstr points to the first instruction to be processed in the analysis
       Instruction * EntryInstr;
+      // Storage for every Info created during the analysis
+      InfoPool<Info> Pool;
+      // Iterate over basic blocks instead of instructions
+      bool BlockSummaryMode;
+      // Keep facts only on the edges leaving blocks, see setBoundaryMode()
+      bool BoundaryMode;
+      // Whether the edges inside blocks were dropped after solving, and the block whose
+      // ones were replayed for reading (~0U for none), see materializeBlock()
+      bool InnerEdgesDropped;
+      unsigned MaterializedBlock;
+      // Block-granularity view of the edge graph, see buildBlockChains().
+      // The chain of block b is ChainNodes[ChainOffsets[b] .. ChainOffsets[b+1]).
+      std::vector<BasicBlock *> Blocks;
+      std::vector<unsigned> ChainOffsets;
+      std::vector<unsigned> ChainNodes;
+      // Block of each node, ~0U for the dummy node and nodes outside every chain
+      std::vector<unsigned> NodeToBlock;
+      // Position of each node in reverse postorder, see computeNodeOrder()
+      std::vector<unsigned> NodeRank;
+      // Iterate in weak topological order instead of using the worklist
+      bool WeakTopologicalMode;
+      // Weak topological order of the nodes, see computeWeakTopologicalOrder().
+      // For the head of a component at position i, WtoComponentEnd[i] is one past the
+      // component's last position; for a plain node it is 0.
+      std::vector<unsigned> WtoNodes;
+      std::vector<unsigned> WtoComponentEnd;
+      // Nodes whose incoming edges changed since they were last visited
+      BitVector Dirty;
+      // Solve only on the nodes the analysis declares relevant, see buildSparseGraph()
+      bool SparseMode;
+      // Nodes the sparse solver visits
+      BitVector Kept;
+      // While solving sparsely, the edge whose info stands for each edge id; empty otherwise
+      std::vector<unsigned> EdgeRep;
+      // For a skipped node entered from a kept one, the kept nodes its facts flow on to:
+      // SparseTargets[SparseTargetOffsets[n] .. SparseTargetOffsets[n+1])
+      std::vector<unsigned> SparseTargetOffsets;
+      std::vector<unsigned> SparseTargets;
+      // runDeltaWorklist() once delta mode is enabled, otherwise null. Going through a pointer
+      // means Info types that lack subtract() and isEmpty() still work in the other modes.
+      void (DataFlowAnalysis::*DeltaSolver)();
+      // internInfo() and joinInterned() once interning is enabled, otherwise null;
+      // only then does Info need a hash function.
+      Info * (DataFlowAnalysis::*Interner)(Info *);
+      Info * (DataFlowAnalysis::*InternedJoin)(Info *, Info *);
+      // Counters of the last run, see getStats()
+      DataFlowStats Stats;
+      // Fill in the optional parts of Stats
+      bool CollectStats;
+      // Visits made to each node (or block) while CollectStats is set
+      std::vector<unsigned> VisitCounts;
+      // Nodes solved for queries since prepareQueries(), see solveDemand(). The set is
+      // closed under predecessors, so their outgoing edges hold final information.
+      BitVector Solved;
+      // The nodes the current solveDemand() call solves, and its worklist
+      BitVector Demanded;
+      OrderedWorklist DemandWorklist;
 
 
       /*
@@ -102,20 +863,137 @@ class DataFlowAnalysis {
 
          // Dummy instruction null has index 0;
          // Any real instruction's index > 0.
+         IndexToInstr.clear();
+         InstrToIndex.clear();
          InstrToIndex[nullptr] = 0;
-         IndexToInstr[0] = nullptr;
+         IndexToInstr.push_back(nullptr);
 
          unsigned counter = 1;
          for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
             Instruction * instr = &*I;
             InstrToIndex[instr] = counter;
-            IndexToInstr[counter] = instr;
+            IndexToInstr.push_back(instr);
             counter++;
          }
 
          return;
       }
 
+      /*
+       * Utility function:
+       *   Assign edge ids and build the compressed adjacency arrays from PendingEdges.
+       *   Edge ids follow (src, dst) order, so the outgoing edges of node n are exactly the ids
+       *   SuccOffsets[n] .. SuccOffsets[n+1] and SuccList[id] is the destination of edge id.
+       *   PredList[PredOffsets[n] .. PredOffsets[n+1]) holds the sources of the incoming edges of
+       *   node n in ascending order, and PredEdges holds the matching edge ids.
+       *   Must be called once all edges have been added.
+       */
+      void buildAdjacency() {
+         unsigned numNodes = IndexToInstr.size();
+
+         // addEdge() keeps the first content given to an edge, so drop later duplicates.
+         std::stable_sort(PendingEdges.begin(), PendingEdges.end(),
+                          [](const std::pair<Edge, Info *> &a, const std::pair<Edge, Info *> &b) {
+                             return a.first < b.first;
+                          });
+         PendingEdges.erase(std::unique(PendingEdges.begin(), PendingEdges.end(),
+                                        [](const std::pair<Edge, Info *> &a, const std::pair<Edge, Info *> &b) {
+                                           return a.first == b.first;
+                                        }),
+                            PendingEdges.end());
+
+         unsigned numEdges = PendingEdges.size();
+         EdgeToInfo.resize(numEdges);
+         EdgeSrc.resize(numEdges);
+         SuccList.resize(numEdges);
+         PredList.resize(numEdges);
+         PredEdges.resize(numEdges);
+         PredOffsets.assign(numNodes + 1, 0);
+         SuccOffsets.assign(numNodes + 1, 0);
+
+         for (unsigned id = 0; id < numEdges; id++) {
+            const Edge &edge = PendingEdges[id].first;
+            EdgeToInfo[id] = PendingEdges[id].second;
+            EdgeSrc[id] = edge.first;
+            SuccList[id] = edge.second;
+            SuccOffsets[edge.first + 1]++;
+            PredOffsets[edge.second + 1]++;
+         }
+         for (unsigned n = 0; n < numNodes; n++) {
+            SuccOffsets[n + 1] += SuccOffsets[n];
+            PredOffsets[n + 1] += PredOffsets[n];
+         }
+
+         // Edges are visited in (src, dst) order, so every predecessor list comes out sorted.
+         std::vector<unsigned> predFill(PredOffsets.begin(), PredOffsets.end() - 1);
+         for (unsigned id = 0; id < numEdges; id++) {
+            unsigned slot = predFill[SuccList[id]]++;
+            PredList[slot] = EdgeSrc[id];
+            PredEdges[slot] = id;
+         }
+
+         PendingEdges.clear();
+         return;
+      }
+
+      /*
+       * Utility function:
+       *   Get the id of the edge src->dst, or ~0U if there is no such edge.
+       */
+      unsigned getEdgeId(unsigned src, unsigned dst) {
+         auto begin = SuccList.begin() + SuccOffsets[src];
+         auto end = SuccList.begin() + SuccOffsets[src + 1];
+         auto it = std::lower_bound(begin, end, dst);
+         if (it == end || *it != dst)
+            return ~0U;
+         return it - SuccList.begin();
+      }
+
+      /*
+       * Utility function:
+       *   Rank every node by its position in a reverse postorder of the edge graph.
+       *   Edges already point in analysis order, so this is reverse postorder of the CFG
+       *   for forward analyses and postorder for backward ones.
+       *   The depth-first search starts at the dummy node; nodes it cannot reach are ranked
+       *   after it, one search tree at a time in index order.
+       */
+      void computeNodeOrder() {
+         unsigned numNodes = IndexToInstr.size();
+         NodeRank.assign(numNodes, 0);
+
+         BitVector visited(numNodes);
+         std::vector<std::pair<unsigned, unsigned> > stack; // (node, next successor slot)
+         std::vector<unsigned> postorder;
+         unsigned ranked = 0;
+
+         for (unsigned root = 0; root < numNodes; root++) {
+            if (visited.test(root))
+               continue;
+
+            postorder.clear();
+            visited.set(root);
+            stack.push_back(std::make_pair(root, SuccOffsets[root]));
+            while (!stack.empty()) {
+               unsigned n = stack.back().first;
+               unsigned &slot = stack.back().second;
+               if (slot == SuccOffsets[n + 1]) {
+                  postorder.push_back(n);
+                  stack.pop_back();
+                  continue;
+               }
+               unsigned succ = SuccList[slot++];
+               if (!visited.test(succ)) {
+                  visited.set(succ);
+                  stack.push_back(std::make_pair(succ, SuccOffsets[succ]));
+               }
+            }
+
+            for (unsigned i = 0; i < postorder.size(); i++)
+               NodeRank[postorder[i]] = ranked + postorder.size() - 1 - i;
+            ranked += postorder.size();
+         }
+      }
+
       /*
        * Utility function:
        *   Get incoming edges of the instruction identified by index.
@@ -124,26 +1002,21 @@ class DataFlowAnalysis {
       void getIncomingEdges(unsigned index, std::vector<unsigned> * IncomingEdges) {
          assert(IncomingEdges->size() == 0 && "IncomingEdges should be empty.");
 
-         for (auto const &it : EdgeToInfo) {
-            if (it.first.second == index)
-               IncomingEdges->push_back(it.first.first);
-         }
+         IncomingEdges->assign(PredList.begin() + PredOffsets[index],
+                               PredList.begin() + PredOffsets[index + 1]);
          return;
       }
 
       /*
        * Utility function:
-       *   Get incoming edges of the instruction identified by index.
+       *   Get outgoing edges of the instruction identified by index.
        *   OutgoingEdges stores the indices of the destination instructions of the outgoing edges.
        */
       void getOutgoingEdges(unsigned index, std::vector<unsigned> * OutgoingEdges) {
          assert(OutgoingEdges->size() == 0 && "OutgoingEdges should be empty.");
 
-         for (auto const &it : EdgeToInfo) {
-            if (it.first.first == index)
-               OutgoingEdges->push_back(it.first.second);
-         }
-
+         OutgoingEdges->assign(SuccList.begin() + SuccOffsets[index],
+                               SuccList.begin() + SuccOffsets[index + 1]);
          return;
       }
 
@@ -151,11 +1024,11 @@ class DataFlowAnalysis {
        * Utility function:
        *   Insert an edge to EdgeToInfo.
        *   The default initial value for each edge is bottom.
+       *   If the edge already exists its first content is kept.
        */
       void addEdge(Instruction * src, Instruction * dst, Info * content) {
          Edge edge = std::make_pair(InstrToIndex[src], InstrToIndex[dst]);
-         if (EdgeToInfo.count(edge) == 0)
-            EdgeToInfo[edge] = content;
+         PendingEdges.push_back(std::make_pair(edge, content));
          return;
       }
 
@@ -163,7 +1036,10 @@ class DataFlowAnalysis {
        * Initialize EdgeToInfo and EntryInstr for a forward analysis.
        */
       void initializeForwardMap(Function * func) {
-         assignIndiceToInstrs(func);
+         {
+            PhaseTimer timer(CollectStats ? &Stats.IndexTime : nullptr);
+            assignIndiceToInstrs(func);
+         }
 
          for (Function::iterator bi = func->begin(), e = func->end(); bi != e; ++bi) {
             BasicBlock * block = &*bi;
@@ -208,6 +1084,8 @@ class DataFlowAnalysis {
          EntryInstr = (Instruction *) &((func->front()).front());
          addEdge(nullptr, EntryInstr, &InitialState);
 
+         buildAdjacency();
+
          return;
       }
 
@@ -216,7 +1094,10 @@ class DataFlowAnalysis {
        *   Implement the following function in part 3 for backward analyses
        */
       void initializeBackwardMap(Function * func) {
-         assignIndiceToInstrs(func);
+         {
+            PhaseTimer timer(CollectStats ? &Stats.IndexTime : nullptr);
+            assignIndiceToInstrs(func);
+         }
 
          for (Function::iterator bi = func->begin(), e = func->end(); bi != e; ++bi) {
             BasicBlock * block = &*bi;
@@ -261,6 +1142,8 @@ class DataFlowAnalysis {
          EntryInstr = (Instruction *) &((func->back()).back());
          addEdge(nullptr, EntryInstr, &Bottom);
 
+         buildAdjacency();
+
          return;
       }
 
@@ -279,97 +1162,1846 @@ class DataFlowAnalysis {
                               std::vector<unsigned> & OutgoingEdges,
                               std::vector<Info *> & Infos) = 0;
 
-  public:
-    DataFlowAnalysis(Info & bottom, Info & initialState) :
-                           Bottom(bottom), InitialState(initialState),EntryInstr(nullptr) {}
+    /*
+     * The block transfer summary, used in block summary mode.
+     *   BasicBlock * BB: the block to be processed.
+     *   Info * In: the join of the information on the edges entering the block (in analysis order).
+     *   std::vector<unsigned> & OutgoingEdges: the indices of the destinations of the edges leaving the block.
+     *   std::vector<Info *> & Infos: the newly computed information for each of those edges.
+     *
+     * The result must equal running flowfunction over the block's instructions in analysis order.
+     * Return false if there is no summary for BB; the framework then composes the flow functions itself.
+     */
+    virtual bool blockflowfunction(BasicBlock * BB,
+                                   Info * In,
+                                   std::vector<unsigned> & OutgoingEdges,
+                                   std::vector<Info *> & Infos) {
+      return false;
+    }
 
-    virtual ~DataFlowAnalysis() {}
+    /*
+     * Whether I can change the information flowing through it, used in sparse mode.
+     * Return false only if flowfunction passes the information of a single incoming edge
+     * unchanged to every outgoing edge of I.
+     */
+    virtual bool isRelevant(Instruction * I) {
+      return true;
+    }
 
     /*
-     * Print out the analysis results.
+     * The delta transfer function, used in delta mode for every visit of I but the first.
+     *   Info * In: everything that reached I so far.
+     *   Info * Delta: the part of In that is new since the last visit of I; never empty.
+     *   std::vector<unsigned> & OutgoingEdges: as in flowfunction.
+     *   std::vector<Info *> & Infos: for each outgoing edge, information containing at least
+     *     every fact flowfunction would produce from In but not from In - Delta.
      *
-     * Direction:
-     *    Do not change this funciton.
-     *    The autograder will check the output of this function.
+     * Infos must be allocated with allocateInfo(), as in flowfunction.
+     * Return false to have the framework call flowfunction instead.
      */
-    void print() {
-         for (auto const &it : EdgeToInfo) {
-            errs() << "Edge " << it.first.first << "->" "Edge " << it.first.second << ":";
-            if(it.second == NULL) errs() << "derp\n";
-            (it.second)->print();
-         }
+    virtual bool deltaflowfunction(Instruction * I,
+                                   Info * In,
+                                   Info * Delta,
+                                   std::vector<unsigned> & OutgoingEdges,
+                                   std::vector<Info *> & Infos) {
+      return false;
     }
 
-    Instruction * getIndexToInstr(unsigned i) {
-      return IndexToInstr[i];
+    void callFlowFunction(Instruction * I,
+                          std::vector<unsigned> & IncomingEdges,
+                          std::vector<unsigned> & OutgoingEdges,
+                          std::vector<Info *> & Infos,
+                          std::true_type) {
+      flowfunction(I, IncomingEdges, OutgoingEdges, Infos);
     }
 
-    unsigned getInstrToIndex(Instruction *i) {
-      return InstrToIndex[i];
+    void callFlowFunction(Instruction * I,
+                          std::vector<unsigned> & IncomingEdges,
+                          std::vector<unsigned> & OutgoingEdges,
+                          std::vector<Info *> & Infos,
+                          std::false_type) {
+      static_cast<Analysis *>(this)->Analysis::flowfunction(I, IncomingEdges, OutgoingEdges, Infos);
     }
 
-    Info * getEdgeToInfo(Edge e) {
-      return EdgeToInfo[e];
+    bool callBlockFlowFunction(BasicBlock * BB,
+                               Info * In,
+                               std::vector<unsigned> & OutgoingEdges,
+                               std::vector<Info *> & Infos,
+                               std::true_type) {
+      return blockflowfunction(BB, In, OutgoingEdges, Infos);
+    }
+
+    bool callBlockFlowFunction(BasicBlock * BB,
+                               Info * In,
+                               std::vector<unsigned> & OutgoingEdges,
+                               std::vector<Info *> & Infos,
+                               std::false_type) {
+      return static_cast<Analysis *>(this)->Analysis::blockflowfunction(BB, In, OutgoingEdges, Infos);
+    }
+
+    bool callIsRelevant(Instruction * I, std::true_type) {
+      return isRelevant(I);
+    }
+
+    bool callIsRelevant(Instruction * I, std::false_type) {
+      return static_cast<Analysis *>(this)->Analysis::isRelevant(I);
     }
 
+    bool callDeltaFlowFunction(Instruction * I,
+                               Info * In,
+                               Info * Delta,
+                               std::vector<unsigned> & OutgoingEdges,
+                               std::vector<Info *> & Infos,
+                               std::true_type) {
+      return deltaflowfunction(I, In, Delta, OutgoingEdges, Infos);
+    }
 
+    bool callDeltaFlowFunction(Instruction * I,
+                               Info * In,
+                               Info * Delta,
+                               std::vector<unsigned> & OutgoingEdges,
+                               std::vector<Info *> & Infos,
+                               std::false_type) {
+      return static_cast<Analysis *>(this)->Analysis::deltaflowfunction(I, In, Delta, OutgoingEdges, Infos);
+    }
 
     /*
-     * This function implements the work list algorithm in the following steps:
-     * (1) Initialize info of each edge to bottom
-     * (2) Initialize the worklist
-     * (3) Compute until the worklist is empty
-     *
-     * Direction:
-     *   Implement the rest of the function.
-     *   You may not change anything before "// (2) Initialize the worklist".
+     * Pick the edge initialization for the analysis direction at compile time.
      */
-   void runWorklistAlgorithm(Function * func) {
-         std::deque<unsigned> worklist;
+    void initializeMap(Function * func, std::true_type) {
+      InnerEdgesDropped = false;
+      MaterializedBlock = ~0U;
+      initializeForwardMap(func);
+    }
 
-         // (1) Initialize info of each edge to bottom
-         if (Direction)
-            initializeForwardMap(func);
-         else
-            initializeBackwardMap(func);
+    void initializeMap(Function * func, std::false_type) {
+      InnerEdgesDropped = false;
+      MaterializedBlock = ~0U;
+      initializeBackwardMap(func);
+    }
 
-         assert(EntryInstr != nullptr && "Entry instruction is null.");
+    /*
+     * Store info on edge unless the edge already holds an equal value.
+     * Returns true if the edge changed.
+     */
+    bool updateEdge(unsigned edge, Info * info) {
+      Stats.EqualityChecks++;
+      if (Interner) {
+         // Interned values are equal only if they are the same value.
+         info = (this->*Interner)(info);
+         if (EdgeToInfo[edge] == info)
+            return false;
+         if (!Pool.isInterned(EdgeToInfo[edge]) && Info::equals(EdgeToInfo[edge], info))
+            return false;
+      }
+      else if (Info::equals(EdgeToInfo[edge], info))
+         return false;
+
+      Stats.EdgeUpdates++;
+      Pool.retain(info);
+      Pool.release(EdgeToInfo[edge]);
+      EdgeToInfo[edge] = info;
+      return true;
+    }
+
+    /*
+     * Run the flow function of node n and store the results on its outgoing edges.
+     * The destinations of the edges that changed are appended to Changed.
+     */
+    void visitNode(unsigned n, std::vector<unsigned> & Changed) {
+      std::vector<unsigned> incomingEdges;
+      std::vector<unsigned> outgoingEdges;
+
+      getIncomingEdges(n, &incomingEdges);
+      getOutgoingEdges(n, &outgoingEdges);
+
+      Stats.FlowFunctionCalls++;
+      Stats.Joins += incomingEdges.size();
+
+      std::vector<Info *> info_o;
+      callFlowFunction(IndexToInstr[n], incomingEdges, outgoingEdges, info_o, DynamicDispatch());
+
+      // The outgoing edges of n are the consecutive ids starting at SuccOffsets[n].
+      unsigned firstEdge = SuccOffsets[n];
+      for (unsigned i = 0; i < info_o.size(); i++) {
+         if (updateEdge(firstEdge + i, info_o[i]))
+            Changed.push_back(outgoingEdges[i]);
+      }
+
+      // Values that did not replace anything can be reused right away.
+      for (Info * info : info_o) {
+         Pool.releaseIfUnused(info);
+      }
+    }
 
-         // (2) Initialize the work list
-         unsigned node = 1;
-         for(inst_iterator I = inst_begin(func), E = inst_end(func); I != E; I++) {
-            worklist.push_back(node++);
+    /*
+     * Group the nodes of every basic block into the chain the edges connect them in,
+     * in analysis order: the head receives all edges entering the block and the tail
+     * emits all edges leaving it. Phi nodes other than the first one have no edges and
+     * are not part of any chain.
+     */
+    void buildBlockChains(Function * func) {
+      Blocks.clear();
+      ChainNodes.clear();
+      ChainOffsets.assign(1, 0);
+      NodeToBlock.assign(IndexToInstr.size(), ~0U);
+
+      for (BasicBlock &BB : *func) {
+         unsigned block = Blocks.size();
+         unsigned start = ChainNodes.size();
+         Blocks.push_back(&BB);
+
+         for (Instruction &instr : BB) {
+            if (isa<PHINode>(&instr) && &instr != &BB.front())
+               continue;
+            unsigned n = InstrToIndex.lookup(&instr);
+            ChainNodes.push_back(n);
+            NodeToBlock[n] = block;
          }
+         if (!Direction)
+            std::reverse(ChainNodes.begin() + start, ChainNodes.end());
+
+         ChainOffsets.push_back(ChainNodes.size());
+      }
+    }
 
-         // (3) Compute until the work list is empty
-         while(!worklist.empty()) {
-            unsigned n = worklist.front();
-            worklist.pop_front();
+    /*
+     * Fixpoint over basic blocks instead of instructions.
+     * A block visit either applies the analysis' blockflowfunction summary to the join of the
+     * block's incoming facts, or composes the flow functions of its chain. Only changes on the
+     * edges leaving a block put other blocks on the worklist. Blocks that were summarized get
+     * their intra-block edges filled in by one final sweep. In boundary mode that sweep is
+     * skipped and composed blocks drop their intra-block edges after each visit, so only
+     * one block's worth of them is alive at a time.
+     */
+    void runBlockWorklist(Function * func) {
+      buildBlockChains(func);
+
+      unsigned numBlocks = Blocks.size();
+      std::vector<bool> summarized(numBlocks, false);
+      std::vector<bool> composed(numBlocks, false);
+
+      // Blocks are ordered by the rank of their chain heads.
+      std::vector<unsigned> blockRank(numBlocks);
+      for (unsigned b = 0; b < numBlocks; b++)
+         blockRank[b] = NodeRank[ChainNodes[ChainOffsets[b]]];
+
+      OrderedWorklist worklist;
+      worklist.init(blockRank);
+      for (unsigned b = 0; b < numBlocks; b++)
+         countPush(worklist, b);
+
+      std::vector<unsigned> changed;
+      while (!worklist.empty()) {
+         unsigned b = worklist.pop();
+         countVisit(b);
+
+         unsigned head = ChainNodes[ChainOffsets[b]];
+         unsigned tail = ChainNodes[ChainOffsets[b + 1] - 1];
+
+         changed.clear();
+         if (!composed[b]) {
+            Info * in = Pool.allocate();
+            for (unsigned k = PredOffsets[head]; k < PredOffsets[head + 1]; k++)
+               Info::join(in, EdgeToInfo[PredEdges[k]], in);
+            Stats.Joins += PredOffsets[head + 1] - PredOffsets[head];
 
-            std::vector<unsigned> incomingEdges;
             std::vector<unsigned> outgoingEdges;
+            std::vector<Info *> info_o;
+            getOutgoingEdges(tail, &outgoingEdges);
+            Stats.BlockFlowFunctionCalls++;
+            if (callBlockFlowFunction(Blocks[b], in, outgoingEdges, info_o, DynamicDispatch())) {
+               summarized[b] = true;
+               unsigned firstEdge = SuccOffsets[tail];
+               for (unsigned i = 0; i < info_o.size(); i++) {
+                  if (updateEdge(firstEdge + i, info_o[i]))
+                     changed.push_back(outgoingEdges[i]);
+               }
+               for (Info * info : info_o)
+                  Pool.releaseIfUnused(info);
+            }
+            else {
+               composed[b] = true;
+            }
+            Pool.releaseIfUnused(in);
+         }
+
+         if (composed[b]) {
+            std::vector<unsigned> ignored;
+            for (unsigned k = ChainOffsets[b]; k + 1 < ChainOffsets[b + 1]; k++) {
+               ignored.clear();
+               visitNode(ChainNodes[k], ignored);
+            }
+            visitNode(tail, changed);
+            if (BoundaryMode)
+               dropInnerEdges(b);
+         }
+
+         for (unsigned dst : changed) {
+            unsigned next = NodeToBlock[dst];
+            if (next != ~0U)
+               countPush(worklist, next);
+         }
+      }
+
+      if (BoundaryMode) {
+         InnerEdgesDropped = true;
+         return;
+      }
+
+      // Materialize the per-instruction facts of summarized blocks.
+      std::vector<unsigned> ignored;
+      for (unsigned b = 0; b < numBlocks; b++) {
+         if (!summarized[b])
+            continue;
+         for (unsigned k = ChainOffsets[b]; k < ChainOffsets[b + 1]; k++) {
+            ignored.clear();
+            visitNode(ChainNodes[k], ignored);
+         }
+      }
+    }
+
+    /*
+     * Whether edge id leaves a node of a chain other than its tail, so that in boundary
+     * mode it holds information only while its block is materialized.
+     */
+    bool isInnerEdge(unsigned id) {
+      unsigned src = EdgeSrc[id];
+      unsigned b = NodeToBlock[src];
+      return b != ~0U && src != ChainNodes[ChainOffsets[b + 1] - 1];
+    }
+
+    /*
+     * Put bottom back on the edges inside block b.
+     */
+    void dropInnerEdges(unsigned b) {
+      for (unsigned k = ChainOffsets[b]; k + 1 < ChainOffsets[b + 1]; k++) {
+         unsigned n = ChainNodes[k];
+         for (unsigned id = SuccOffsets[n]; id < SuccOffsets[n + 1]; id++) {
+            Pool.release(EdgeToInfo[id]);
+            EdgeToInfo[id] = &Bottom;
+         }
+      }
+    }
+
+    /*
+     * After a boundary mode run, give the edges inside block b their information back by
+     * replaying its flow functions on the facts entering it, which are final. The edges
+     * of the block replayed before are dropped again.
+     */
+    void materializeBlock(unsigned b) {
+      if (b == MaterializedBlock)
+         return;
+      releaseReplayedBlock();
+
+      std::vector<unsigned> ignored;
+      for (unsigned k = ChainOffsets[b]; k + 1 < ChainOffsets[b + 1]; k++) {
+         ignored.clear();
+         visitNode(ChainNodes[k], ignored);
+      }
+      MaterializedBlock = b;
+    }
+
+    void releaseReplayedBlock() {
+      if (MaterializedBlock != ~0U)
+         dropInnerEdges(MaterializedBlock);
+      MaterializedBlock = ~0U;
+    }
+
+    /*
+     * Write the information on edge id with Writer. Values replayed inside a block are
+     * freed with it, so their addresses may come back for other values.
+     */
+    void writeEdgeValue(EdgeValueWriter<Info> & Writer, unsigned id) {
+      Info * info = getEdgeInfo(id);
+      Writer.write(info);
+      if (InnerEdgesDropped && isInnerEdge(id))
+         Writer.forget(info);
+    }
+
+    /*
+     * Append a weak topological order of nodes to WtoNodes (Bourdoncle's hierarchical
+     * decomposition): the strongly connected components of the subgraph induced by nodes,
+     * in topological order. A component is laid out as its head, the node with the lowest
+     * reverse postorder rank (the loop entry), followed by the decomposition of the rest of
+     * the component with the head removed. Tarjan's algorithm is run with an explicit stack,
+     * so only loop nesting depth turns into recursion.
+     */
+    void decompose(std::vector<unsigned> & nodes, BitVector & member,
+                   std::vector<unsigned> & index, std::vector<unsigned> & lowlink) {
+      const unsigned Unvisited = ~0U;
+
+      std::sort(nodes.begin(), nodes.end(),
+                [this](unsigned a, unsigned b) { return NodeRank[a] < NodeRank[b]; });
+      for (unsigned n : nodes)
+         member.set(n);
+
+      std::vector<std::vector<unsigned> > components;
+      std::vector<std::pair<unsigned, unsigned> > callStack; // (node, next successor slot)
+      std::vector<unsigned> sccStack;
+      BitVector onStack(IndexToInstr.size());
+      unsigned counter = 0;
+
+      for (unsigned root : nodes) {
+         if (index[root] != Unvisited)
+            continue;
+
+         index[root] = lowlink[root] = counter++;
+         sccStack.push_back(root);
+         onStack.set(root);
+         callStack.push_back(std::make_pair(root, SuccOffsets[root]));
+
+         while (!callStack.empty()) {
+            unsigned v = callStack.back().first;
+            unsigned &slot = callStack.back().second;
+
+            if (slot < SuccOffsets[v + 1]) {
+               unsigned w = SuccList[slot++];
+               if (!member.test(w))
+                  continue;
+               if (index[w] == Unvisited) {
+                  index[w] = lowlink[w] = counter++;
+                  sccStack.push_back(w);
+                  onStack.set(w);
+                  callStack.push_back(std::make_pair(w, SuccOffsets[w]));
+               }
+               else if (onStack.test(w)) {
+                  lowlink[v] = std::min(lowlink[v], index[w]);
+               }
+               continue;
+            }
+
+            callStack.pop_back();
+            if (!callStack.empty()) {
+               unsigned parent = callStack.back().first;
+               lowlink[parent] = std::min(lowlink[parent], lowlink[v]);
+            }
+            if (lowlink[v] == index[v]) {
+               components.push_back(std::vector<unsigned>());
+               unsigned w;
+               do {
+                  w = sccStack.back();
+                  sccStack.pop_back();
+                  onStack.reset(w);
+                  components.back().push_back(w);
+               } while (w != v);
+            }
+         }
+      }
+
+      // Leave the bookkeeping clean for the recursive calls.
+      for (unsigned n : nodes) {
+         member.reset(n);
+         index[n] = Unvisited;
+      }
+
+      // Tarjan's algorithm finds components in reverse topological order.
+      for (auto it = components.rbegin(); it != components.rend(); ++it) {
+         std::vector<unsigned> &component = *it;
+         if (component.size() == 1 && getEdgeId(component[0], component[0]) == ~0U) {
+            WtoNodes.push_back(component[0]);
+            WtoComponentEnd.push_back(0);
+            continue;
+         }
+
+         auto head = std::min_element(component.begin(), component.end(),
+                                      [this](unsigned a, unsigned b) { return NodeRank[a] < NodeRank[b]; });
+         unsigned position = WtoNodes.size();
+         WtoNodes.push_back(*head);
+         WtoComponentEnd.push_back(0);
+
+         component.erase(head);
+         decompose(component, member, index, lowlink);
+         WtoComponentEnd[position] = WtoNodes.size();
+      }
+    }
+
+    void computeWeakTopologicalOrder() {
+      unsigned numNodes = IndexToInstr.size();
+      WtoNodes.clear();
+      WtoComponentEnd.clear();
+
+      // The dummy node is never visited.
+      std::vector<unsigned> nodes;
+      for (unsigned n = 1; n < numNodes; n++)
+         nodes.push_back(n);
+
+      BitVector member(numNodes);
+      std::vector<unsigned> index(numNodes, ~0U);
+      std::vector<unsigned> lowlink(numNodes, 0);
+      decompose(nodes, member, index, lowlink);
+    }
+
+    /*
+     * Visit n if one of its incoming edges changed since its last visit.
+     */
+    void visitIfDirty(unsigned n, std::vector<unsigned> & changed) {
+      if (!Dirty.test(n))
+         return;
+      Dirty.reset(n);
+      countVisit(n);
+
+      changed.clear();
+      visitNode(n, changed);
+      for (unsigned dst : changed)
+         Dirty.set(dst);
+    }
+
+    /*
+     * Bourdoncle's recursive iteration strategy over WtoNodes[begin .. end):
+     * plain nodes are visited once, and a component repeats its head and body until
+     * its head is stable, so inner loops settle before the enclosing loop goes around again.
+     */
+    void iterateWto(unsigned begin, unsigned end, std::vector<unsigned> & changed) {
+      unsigned position = begin;
+      while (position < end) {
+         unsigned componentEnd = WtoComponentEnd[position];
+         unsigned n = WtoNodes[position];
+         if (componentEnd == 0) {
+            visitIfDirty(n, changed);
+            position++;
+            continue;
+         }
+
+         do {
+            visitIfDirty(n, changed);
+            iterateWto(position + 1, componentEnd, changed);
+         } while (Dirty.test(n));
+         position = componentEnd;
+      }
+    }
+
+    void runWeakTopologicalOrder() {
+      computeWeakTopologicalOrder();
+
+      Dirty.clear();
+      Dirty.resize(IndexToInstr.size(), true);
+      // Every node starts out dirty; that set is the closest thing to a worklist here.
+      Stats.WorklistPeak = WtoNodes.size();
+      std::vector<unsigned> changed;
+      iterateWto(0, WtoNodes.size(), changed);
+    }
+
+    /*
+     * Reduce the edge graph to the nodes that can change the information: those the
+     * analysis declares relevant and those that join several incoming edges. A skipped
+     * node has a single incoming edge and passes its information on unchanged, so its
+     * outgoing edges are represented by that incoming edge (EdgeRep), and every skipped
+     * node forms a tree hanging off a kept node. Skipped nodes that no kept node leads
+     * to (closed cycles in unreachable code) are kept.
+     */
+    void buildSparseGraph() {
+      unsigned numNodes = IndexToInstr.size();
+      unsigned numEdges = EdgeToInfo.size();
+
+      Kept.clear();
+      Kept.resize(numNodes);
+      Kept.set(0);
+      for (unsigned n = 1; n < numNodes; n++) {
+         if (PredOffsets[n + 1] - PredOffsets[n] != 1 || callIsRelevant(IndexToInstr[n], DynamicDispatch()))
+            Kept.set(n);
+      }
+
+      // The root of a tree of skipped nodes is entered from a kept node.
+      auto isRoot = [&](unsigned n) {
+         return !Kept.test(n) && Kept.test(PredList[PredOffsets[n]]);
+      };
+
+      BitVector reached(numNodes);
+      std::vector<unsigned> stack;
+      for (unsigned n = 1; n < numNodes; n++) {
+         if (!isRoot(n))
+            continue;
+         stack.push_back(n);
+         while (!stack.empty()) {
+            unsigned s = stack.back();
+            stack.pop_back();
+            reached.set(s);
+            for (unsigned id = SuccOffsets[s]; id < SuccOffsets[s + 1]; id++) {
+               if (!Kept.test(SuccList[id]))
+                  stack.push_back(SuccList[id]);
+            }
+         }
+      }
+      for (unsigned n = 1; n < numNodes; n++) {
+         if (!Kept.test(n) && !reached.test(n))
+            Kept.set(n);
+      }
+
+      EdgeRep.resize(numEdges);
+      for (unsigned id = 0; id < numEdges; id++)
+         EdgeRep[id] = id;
+
+      SparseTargetOffsets.assign(1, 0);
+      SparseTargets.clear();
+      for (unsigned n = 0; n < numNodes; n++) {
+         if (n > 0 && isRoot(n)) {
+            stack.push_back(n);
+            while (!stack.empty()) {
+               unsigned s = stack.back();
+               stack.pop_back();
+               unsigned rep = EdgeRep[PredEdges[PredOffsets[s]]];
+               for (unsigned id = SuccOffsets[s]; id < SuccOffsets[s + 1]; id++) {
+                  EdgeRep[id] = rep;
+                  if (Kept.test(SuccList[id]))
+                     SparseTargets.push_back(SuccList[id]);
+                  else
+                     stack.push_back(SuccList[id]);
+               }
+            }
+         }
+         SparseTargetOffsets.push_back(SparseTargets.size());
+      }
+    }
 
+    /*
+     * The worklist algorithm over the kept nodes of buildSparseGraph(). Afterwards every
+     * skipped edge gets the information of its representative, so the dense results
+     * look exactly as if every node had been visited.
+     */
+    void runSparseWorklist() {
+      buildSparseGraph();
+
+      OrderedWorklist worklist;
+      worklist.init(NodeRank);
+      for (unsigned n = 1; n < IndexToInstr.size(); n++) {
+         if (Kept.test(n))
+            countPush(worklist, n);
+      }
+
+      std::vector<unsigned> changed;
+      while (!worklist.empty()) {
+         unsigned n = worklist.pop();
+         countVisit(n);
+
+         changed.clear();
+         visitNode(n, changed);
+         for (unsigned dst : changed) {
+            if (Kept.test(dst)) {
+               countPush(worklist, dst);
+               continue;
+            }
+            for (unsigned k = SparseTargetOffsets[dst]; k < SparseTargetOffsets[dst + 1]; k++)
+               countPush(worklist, SparseTargets[k]);
+         }
+      }
+
+      for (unsigned id = 0; id < EdgeRep.size(); id++) {
+         if (EdgeRep[id] == id)
+            continue;
+         Info * info = EdgeToInfo[EdgeRep[id]];
+         Pool.retain(info);
+         Pool.release(EdgeToInfo[id]);
+         EdgeToInfo[id] = info;
+      }
+      EdgeRep.clear();
+    }
+
+    /*
+     * Worklist algorithm that propagates only newly added facts. Every node keeps the join of
+     * everything that reached it (in) and what arrived since its last visit (pending). The
+     * first visit of a node runs flowfunction; later visits skip the node if pending adds
+     * nothing to in, and otherwise hand just the new facts to deltaflowfunction. An edge only
+     * grows: the facts that are new to it are added to it and to the pending facts of its
+     * destination. For monotone transfer functions this reaches the same fixpoint as the
+     * plain worklist algorithm.
+     *
+     * Most nodes are visited only once, so in is built on the second visit, from the edges.
+     * Pending then serves as the delta as it is; it may repeat facts the first visit already
+     * saw, which only costs deltaflowfunction some work.
+     *
+     * Requires Info to provide isEmpty() and a static subtract(info1, info2, result) that
+     * computes info1 - info2 and allows result to alias info1.
+     */
+    void runDeltaWorklist() {
+      unsigned numNodes = IndexToInstr.size();
+      std::vector<Info> in(numNodes);
+      std::vector<Info> pending(numNodes);
+      std::vector<bool> visited(numNodes, false);
+      std::vector<bool> haveIn(numNodes, false);
+
+      OrderedWorklist worklist;
+      worklist.init(NodeRank);
+      for (unsigned n = 1; n < numNodes; n++)
+         countPush(worklist, n);
+
+      std::vector<unsigned> incomingEdges;
+      std::vector<unsigned> outgoingEdges;
+      std::vector<Info *> info_o;
+      while (!worklist.empty()) {
+         unsigned n = worklist.pop();
+         countVisit(n);
+
+         outgoingEdges.clear();
+         info_o.clear();
+         getOutgoingEdges(n, &outgoingEdges);
+
+         bool computed = false;
+         if (visited[n]) {
+            if (haveIn[n]) {
+               Info::subtract(&pending[n], &in[n], &pending[n]);
+               Stats.EqualityChecks++;
+               if (pending[n].isEmpty())
+                  continue;
+
+               Info::join(&in[n], &pending[n], &in[n]);
+               Stats.Joins++;
+            }
+            else {
+               haveIn[n] = true;
+               for (unsigned k = PredOffsets[n]; k < PredOffsets[n + 1]; k++)
+                  Info::join(&in[n], EdgeToInfo[PredEdges[k]], &in[n]);
+               Stats.Joins += PredOffsets[n + 1] - PredOffsets[n];
+            }
+            Stats.FlowFunctionCalls++;
+            computed = callDeltaFlowFunction(IndexToInstr[n], &in[n], &pending[n],
+                                             outgoingEdges, info_o, DynamicDispatch());
+         }
+         else {
+            visited[n] = true;
+         }
+         pending[n] = Info();
+
+         if (!computed) {
+            incomingEdges.clear();
             getIncomingEdges(n, &incomingEdges);
-            getOutgoingEdges(n, &outgoingEdges);
+            Stats.FlowFunctionCalls++;
+            Stats.Joins += incomingEdges.size();
+            callFlowFunction(IndexToInstr[n], incomingEdges, outgoingEdges, info_o, DynamicDispatch());
+         }
 
-            std::vector<Info *> info_o;
-            flowfunction(IndexToInstr[n], incomingEdges, outgoingEdges, info_o);
+         unsigned firstEdge = SuccOffsets[n];
+         for (unsigned i = 0; i < info_o.size(); i++) {
+            unsigned edge = firstEdge + i;
+            Info * old = EdgeToInfo[edge];
+            Info * fresh = info_o[i];
+            // The values in info_o may be shared by several edges and are released after
+            // the loop; only the difference computed here belongs to this edge.
+            Info * difference = nullptr;
+            Stats.EqualityChecks++;
+            if (old->isEmpty()) {
+               // The first facts on this edge: take the value as it is.
+               if (fresh->isEmpty())
+                  continue;
+               updateEdge(edge, fresh);
+            }
+            else {
+               fresh = difference = Pool.allocate();
+               Info::subtract(info_o[i], old, fresh);
+               if (fresh->isEmpty()) {
+                  Pool.releaseIfUnused(difference);
+                  continue;
+               }
+
+               if (Pool.isExclusive(old)) {
+                  Info::join(old, fresh, old);
+               }
+               else {
+                  Info * grown = Pool.allocate();
+                  Info::join(old, fresh, grown);
+                  Pool.retain(grown);
+                  Pool.release(old);
+                  EdgeToInfo[edge] = grown;
+               }
+               Stats.EdgeUpdates++;
+            }
+
+            // A node that was never visited reads its edges on the first visit anyway.
+            unsigned dst = SuccList[edge];
+            if (visited[dst])
+               Info::join(&pending[dst], fresh, &pending[dst]);
+            countPush(worklist, dst);
+            if (difference)
+               Pool.releaseIfUnused(difference);
+         }
+
+         for (Info * info : info_o)
+            Pool.releaseIfUnused(info);
+      }
+    }
+
+    /*
+     * Count a visit of node (or block) n.
+     */
+    void countVisit(unsigned n) {
+      Stats.NodeVisits++;
+      if (CollectStats)
+         Stats.Iterations = std::max(Stats.Iterations, ++VisitCounts[n]);
+    }
+
+    /*
+     * Push item onto worklist, counting suppressed pushes and the peak worklist size.
+     */
+    void countPush(OrderedWorklist & worklist, unsigned item) {
+      if (!worklist.push(item))
+         Stats.SuppressedPushes++;
+      else if (worklist.size() > Stats.WorklistPeak)
+         Stats.WorklistPeak = worklist.size();
+    }
 
-            for(unsigned i = 0; i < info_o.size(); i++) {
-               Edge edge = std::make_pair(n, outgoingEdges[i]);
-               if(!Info::equals(EdgeToInfo[edge], info_o[i])) {
+    /*
+     * Solve what node target depends on and was not solved yet: the nodes with a path of
+     * edges to target, target included. Solved nodes depend only on solved nodes, so
+     * their edges are final and the worklist is confined to the new ones; edges into
+     * unsolved nodes are written but no one reads them before those nodes are solved.
+     */
+    void solveDemand(unsigned target) {
+      if (target == 0 || target >= Solved.size() || Solved.test(target))
+         return;
+      PhaseTimer timer(CollectStats ? &Stats.SolveTime : nullptr);
+
+      std::vector<unsigned> region(1, target);
+      Solved.set(target);
+      for (unsigned i = 0; i < region.size(); i++) {
+         unsigned n = region[i];
+         for (unsigned k = PredOffsets[n]; k < PredOffsets[n + 1]; k++) {
+            unsigned pred = PredList[k];
+            if (pred != 0 && !Solved.test(pred)) {
+               Solved.set(pred);
+               region.push_back(pred);
+            }
+         }
+      }
+
+      solveRegion(region);
+    }
 
-                  EdgeToInfo[edge] = info_o[i];
-                  worklist.push_back(outgoingEdges[i]);
+    /*
+     * The worklist algorithm confined to the nodes of region, whose incoming edges from
+     * elsewhere must already hold their final information.
+     */
+    void solveRegion(const std::vector<unsigned> & region) {
+      for (unsigned n : region) {
+         Demanded.set(n);
+         countPush(DemandWorklist, n);
+      }
+
+      std::vector<unsigned> changed;
+      while (!DemandWorklist.empty()) {
+         unsigned n = DemandWorklist.pop();
+         countVisit(n);
+
+         changed.clear();
+         visitNode(n, changed);
+         for (unsigned dst : changed) {
+            if (Demanded.test(dst))
+               countPush(DemandWorklist, dst);
+         }
+      }
+
+      for (unsigned n : region)
+         Demanded.reset(n);
+    }
+
+    /*
+     * The nodes reachable from seeds along the edges, seeds included.
+     */
+    std::vector<unsigned> collectSuccessors(const std::vector<unsigned> & seeds) {
+      BitVector seen(IndexToInstr.size());
+      std::vector<unsigned> region;
+      for (unsigned n : seeds) {
+         if (n != 0 && !seen.test(n)) {
+            seen.set(n);
+            region.push_back(n);
+         }
+      }
+      for (unsigned i = 0; i < region.size(); i++) {
+         unsigned n = region[i];
+         for (unsigned k = SuccOffsets[n]; k < SuccOffsets[n + 1]; k++) {
+            unsigned succ = SuccList[k];
+            if (!seen.test(succ)) {
+               seen.set(succ);
+               region.push_back(succ);
+            }
+         }
+      }
+      return region;
+    }
+
+    /*
+     * The node whose flow function covers I: phi nodes are all handled by the first phi
+     * of their block.
+     */
+    unsigned nodeOf(Instruction * I) {
+      if (isa<PHINode>(I))
+         I = &I->getParent()->front();
+      return InstrToIndex.lookup(I);
+    }
+
+    /*
+     * reanalyze() for edits that keep every instruction, its index and the edges.
+     */
+    void reanalyzeInPlace(const std::vector<Instruction *> & Changed) {
+      std::vector<unsigned> seeds;
+      for (Instruction * I : Changed)
+         seeds.push_back(nodeOf(I));
+      std::vector<unsigned> region = collectSuccessors(seeds);
+
+      for (unsigned n : region) {
+         for (unsigned id = SuccOffsets[n]; id < SuccOffsets[n + 1]; id++) {
+            Pool.release(EdgeToInfo[id]);
+            EdgeToInfo[id] = &Bottom;
+         }
+      }
+      solveRegion(region);
+    }
+
+    /*
+     * reanalyze() for edits that insert or delete instructions or change edges. The
+     * facts are carried over to the new indices, the edges that did not exist before
+     * mark where the changes start, and so do the destinations of the edges that are
+     * gone, since their joins lost an input.
+     */
+    void reanalyzeStructure(Function * func, const std::vector<Instruction *> & Changed,
+                            const std::vector<Instruction *> & Deleted) {
+      std::vector<Instruction *> oldInstrs;
+      DenseMap<Instruction *, unsigned> oldIndex;
+      std::vector<unsigned> oldSrc;
+      std::vector<unsigned> oldDst;
+      std::vector<Info *> oldInfo;
+      oldInstrs.swap(IndexToInstr);
+      oldIndex.swap(InstrToIndex);
+      oldSrc.swap(EdgeSrc);
+      oldDst.swap(SuccList);
+      oldInfo.swap(EdgeToInfo);
+
+      // Old index -> new index, ~0U for the deleted instructions.
+      assignIndiceToInstrs(func);
+      std::vector<unsigned> newIndex(oldInstrs.size(), ~0U);
+      newIndex[0] = 0;
+      for (unsigned i = 1; i < oldInstrs.size(); i++) {
+         auto iter = InstrToIndex.find(oldInstrs[i]);
+         if (iter != InstrToIndex.end())
+            newIndex[i] = iter->second;
+      }
+      for (Instruction * I : Deleted) {
+         auto iter = oldIndex.find(I);
+         if (iter != oldIndex.end())
+            newIndex[iter->second] = ~0U;
+      }
+
+      // Each distinct old value once, in the new numbering.
+      std::deque<Info> carried;
+      DenseMap<Info *, unsigned> carriedSlot;
+      std::vector<unsigned> edgeSlot(oldInfo.size());
+      for (unsigned id = 0; id < oldInfo.size(); id++) {
+         auto inserted = carriedSlot.insert(std::make_pair(oldInfo[id], (unsigned)carried.size()));
+         if (inserted.second) {
+            carried.emplace_back();
+            Info::renumber(oldInfo[id], newIndex, &carried.back());
+         }
+         edgeSlot[id] = inserted.first->second;
+      }
+
+      Pool.reset();
+      initializeMap(func, std::integral_constant<bool, Direction>());
+      computeNodeOrder();
+      Solved.clear();
+      Solved.resize(IndexToInstr.size());
+      Demanded.clear();
+      Demanded.resize(IndexToInstr.size());
+      DemandWorklist.init(NodeRank);
+
+      std::vector<unsigned> seeds;
+      for (Instruction * I : Changed)
+         seeds.push_back(nodeOf(I));
+
+      // Deleting a phi other than the first of its block removes no edge, but the flow
+      // function of the first phi covered it. Start again from the closest earlier
+      // instruction still there, whose node is that first phi.
+      for (Instruction * I : Deleted) {
+         auto iter = oldIndex.find(I);
+         if (iter == oldIndex.end())
+            continue;
+         unsigned i = iter->second;
+         while (i > 1 && newIndex[i] == ~0U)
+            i--;
+         if (newIndex[i] != ~0U)
+            seeds.push_back(nodeOf(oldInstrs[i]));
+      }
+
+      std::vector<unsigned> fromSlot(EdgeToInfo.size(), ~0U);
+      for (unsigned id = 0; id < oldSrc.size(); id++) {
+         unsigned src = newIndex[oldSrc[id]];
+         unsigned dst = newIndex[oldDst[id]];
+         unsigned newId = (src == ~0U || dst == ~0U) ? ~0U : getEdgeId(src, dst);
+         if (newId != ~0U)
+            fromSlot[newId] = edgeSlot[id];
+         else if (dst != ~0U)
+            seeds.push_back(dst);
+      }
+      for (unsigned id = 0; id < EdgeToInfo.size(); id++) {
+         if (fromSlot[id] == ~0U)
+            seeds.push_back(EdgeSrc[id] != 0 ? EdgeSrc[id] : SuccList[id]);
+      }
+      std::vector<unsigned> region = collectSuccessors(seeds);
+
+      BitVector affected(IndexToInstr.size());
+      for (unsigned n : region)
+         affected.set(n);
+
+      // The edges leaving unaffected nodes keep their values; the rest start at bottom.
+      std::vector<Info *> pooled(carried.size(), nullptr);
+      for (unsigned id = 0; id < EdgeToInfo.size(); id++) {
+         unsigned src = EdgeSrc[id];
+         if (src == 0 || affected.test(src))
+            continue;
+
+         unsigned slot = fromSlot[id];
+         if (pooled[slot] == nullptr) {
+            pooled[slot] = Pool.allocate();
+            *pooled[slot] = carried[slot];
+         }
+         Pool.retain(pooled[slot]);
+         EdgeToInfo[id] = pooled[slot];
+      }
+
+      solveRegion(region);
+    }
+
+    Info * internInfo(Info * info) {
+      return Pool.intern(info);
+    }
+
+    Info * joinInterned(Info * info1, Info * info2) {
+      return Pool.join(Pool.intern(info1), Pool.intern(info2));
+    }
+
+  protected:
+    /*
+     * Allocate an empty Info owned by this analysis.
+     * Flow functions must create the values they return through this function;
+     * the framework frees them once no edge refers to them any more.
+     */
+    Info * allocateInfo() {
+      return Pool.allocate();
+    }
+
+    /*
+     * Give back a scratch value from allocateInfo() that is not returned to the framework.
+     */
+    void discardInfo(Info * info) {
+      Pool.releaseIfUnused(info);
+    }
+
+    /*
+     * The information on edge e as the solver holds it. In boundary mode the edges inside a
+     * block only hold bottom once solving is done; getEdgeInfo() replays them.
+     */
+    Info * getEdgeToInfo(Edge e) {
+      unsigned id = getEdgeId(e.first, e.second);
+      if (id == ~0U)
+         return nullptr;
+      return EdgeToInfo[EdgeRep.empty() ? id : EdgeRep[id]];
+    }
+
+    /*
+     * The join of the information on the edges entering node index, for flow functions.
+     * The result may be an edge's own value or, with interning, shared with other nodes:
+     * it must not be modified. It can be returned as is, or copied into a value from
+     * allocateInfo() and then given to discardInfo().
+     */
+    Info * joinIncoming(unsigned index, std::vector<unsigned> & IncomingEdges) {
+      if (IncomingEdges.size() == 1)
+         return getEdgeToInfo(std::make_pair(IncomingEdges[0], index));
+
+      if (InternedJoin) {
+         Info * result = nullptr;
+         for (unsigned src : IncomingEdges) {
+            Info * info = getEdgeToInfo(std::make_pair(src, index));
+            Info * joined = result ? (this->*InternedJoin)(result, info) : (this->*Interner)(info);
+            if (result != nullptr && result != joined)
+               Pool.releaseIfUnused(result);
+            result = joined;
+         }
+         return result ? result : Pool.allocate();
+      }
+
+      Info * result = Pool.allocate();
+      for (unsigned src : IncomingEdges)
+         Info::join(result, getEdgeToInfo(std::make_pair(src, index)), result);
+      return result;
+    }
+
+  public:
+    DataFlowAnalysis(Info & bottom, Info & initialState) :
+                           Bottom(bottom), InitialState(initialState),EntryInstr(nullptr),
+                           BlockSummaryMode(false), BoundaryMode(false),
+                           InnerEdgesDropped(false), MaterializedBlock(~0U), WeakTopologicalMode(false),
+                           SparseMode(false), DeltaSolver(nullptr), Interner(nullptr),
+                           InternedJoin(nullptr), CollectStats(false) {}
+
+    virtual ~DataFlowAnalysis() {}
+
+    /*
+     * Iterate over basic blocks rather than instructions, see runBlockWorklist().
+     */
+    void setBlockSummaryMode(bool enable) {
+      BlockSummaryMode = enable;
+    }
+
+    /*
+     * Keep the solution only on the edges leaving basic blocks and the dummy edge, which
+     * takes the block solver. Phi nodes head their blocks, so their facts are among them.
+     * The edges inside a block are recomputed from the facts entering it when read through
+     * getEdgeInfo(), print() or a query, one block at a time: what is read from one block
+     * stays valid until an edge inside another block is read. Takes precedence over the
+     * other modes.
+     */
+    void setBoundaryMode(bool enable) {
+      BoundaryMode = enable;
+    }
+
+    /*
+     * Replace the worklist with iteration in weak topological order, see iterateWto().
+     * Block summary and boundary modes take precedence if set.
+     */
+    void setWeakTopologicalOrder(bool enable) {
+      WeakTopologicalMode = enable;
+    }
+
+    /*
+     * Visit only the nodes for which isRelevant() holds and the nodes joining several
+     * edges, see buildSparseGraph(). The modes above take precedence if set.
+     */
+    void setSparseMode(bool enable) {
+      SparseMode = enable;
+    }
+
+    /*
+     * Propagate only newly added facts, see runDeltaWorklist(). The analysis should provide
+     * deltaflowfunction. The other modes take precedence if set.
+     */
+    void setDeltaMode(bool enable) {
+      DeltaSolver = enable ? &DataFlowAnalysis::runDeltaWorklist : nullptr;
+    }
+
+    /*
+     * Hash-cons the values stored on edges, see InfoPool::intern(): every distinct value is
+     * kept once, edges are compared by pointer and joinIncoming() memoizes its joins.
+     * Info must provide a static hash(Info *) consistent with equals.
+     */
+    void setInterning(bool enable) {
+      Interner = enable ? &DataFlowAnalysis::internInfo : nullptr;
+      InternedJoin = enable ? &DataFlowAnalysis::joinInterned : nullptr;
+    }
+
+    /*
+     * Worklist visits made by the last runWorklistAlgorithm(), and visits saved by
+     * not queueing a node (or block) twice.
+     */
+    unsigned getNumVisits() {
+      return Stats.NodeVisits;
+    }
+
+    unsigned getNumSuppressedVisits() {
+      return Stats.SuppressedPushes;
+    }
+
+    /*
+     * Also record the iteration count and the time spent in each phase, see DataFlowStats.
+     */
+    void setCollectStats(bool enable) {
+      CollectStats = enable;
+    }
+
+    /*
+     * Counters of the last runWorklistAlgorithm(); PrintTime covers the print() calls since.
+     */
+    const DataFlowStats & getStats() {
+      return Stats;
+    }
+
+    /*
+     * Print out the analysis results.
+     *
+     * Direction:
+     *    Do not change this funciton.
+     *    The autograder will check the output of this function.
+     */
+    void print() {
+         print(errs());
+    }
+
+    void print(raw_ostream & OS) {
+         PhaseTimer timer(CollectStats ? &Stats.PrintTime : nullptr);
+         for (unsigned id = 0; id < EdgeToInfo.size(); id++) {
+            OS << "Edge " << EdgeSrc[id] << "->" "Edge " << SuccList[id] << ":";
+            if(getEdgeInfo(id) == NULL) OS << "derp\n";
+            getEdgeInfo(id)->print(OS);
+         }
+         releaseReplayedBlock();
+    }
+
+    /*
+     * Assign the instruction indices of func now instead of in runWorklistAlgorithm, which
+     * assigns the same ones, so that a pre-analysis can use them.
+     */
+    void indexInstructions(Function * func) {
+      assignIndiceToInstrs(func);
+    }
+
+    /*
+     * Build the edges of func as runWorklistAlgorithm does, but put info on all of them
+     * instead of solving: for results that hold at every program point, like those of a
+     * flow-insensitive analysis.
+     */
+    void assignToAllEdges(Function * func, Info & info) {
+      Pool.reset();
+      Stats = DataFlowStats();
+      Stats.Function = func->getName().str();
+
+      initializeMap(func, std::integral_constant<bool, Direction>());
+      Stats.Instructions = IndexToInstr.size() - 1;
+      Stats.Edges = EdgeToInfo.size();
+
+      Info * shared = Pool.allocate();
+      *shared = info;
+      for (unsigned id = 0; id < EdgeToInfo.size(); id++) {
+         Pool.retain(shared);
+         EdgeToInfo[id] = shared;
+      }
+      Solved.clear();
+      Solved.resize(IndexToInstr.size(), true);
+    }
+
+    /*
+     * The solution as a byte string for ResultCache: the number of edges and their values
+     * as an EdgeValueWriter writes them. Edges are not named; the same function always
+     * gets the same ones.
+     */
+    std::string writeResults() {
+      std::string data;
+      raw_string_ostream OS(data);
+      encodeULEB128(EdgeToInfo.size(), OS);
+      EdgeValueWriter<Info> values(OS);
+      for (unsigned id = 0; id < EdgeToInfo.size(); id++)
+         writeEdgeValue(values, id);
+      releaseReplayedBlock();
+      OS.flush();
+      return data;
+    }
+
+    /*
+     * Build the edges of func and put a solution from writeResults() on them, leaving the
+     * analysis as runWorklistAlgorithm() would. Returns false if Data does not fit func;
+     * the analysis must then be run or prepared again.
+     */
+    bool readResults(Function * func, StringRef Data) {
+      Pool.reset();
+      Stats = DataFlowStats();
+      Stats.Function = func->getName().str();
+      Stats.CacheHit = true;
+      PhaseTimer timer(CollectStats ? &Stats.SolveTime : nullptr);
+
+      initializeMap(func, std::integral_constant<bool, Direction>());
+      Stats.Instructions = IndexToInstr.size() - 1;
+      Stats.Edges = EdgeToInfo.size();
+
+      const uint8_t * ptr = Data.bytes_begin();
+      const uint8_t * end = Data.bytes_end();
+      uint64_t numEdges;
+      std::vector<Info *> values, edgeValues;
+      // Ids of either lattice stay below twice the number of instructions.
+      if (!readULEB128(ptr, end, numEdges) || numEdges != EdgeToInfo.size() ||
+          !readEdgeValues(ptr, end, 2 * IndexToInstr.size(), numEdges,
+                          [this]() { return Pool.allocate(); }, values, edgeValues) ||
+          ptr != end)
+         return false;
+
+      for (unsigned id = 0; id < EdgeToInfo.size(); id++) {
+         Pool.retain(edgeValues[id]);
+         EdgeToInfo[id] = edgeValues[id];
+      }
+      for (Info * info : values)
+         Pool.releaseIfUnused(info);
+      Solved.clear();
+      Solved.resize(IndexToInstr.size(), true);
+      return true;
+    }
+
+    /*
+     * Get ready to answer queries about func without solving it: its edges are built and
+     * hold bottom. queryEdge(), queryInfoAfter() and printQuery() then solve only what
+     * the requested point depends on, and later queries reuse that. The answers are
+     * those of runWorklistAlgorithm(), whose modes do not apply here, and stay valid
+     * until func is prepared or run again.
+     */
+    void prepareQueries(Function * func) {
+      Pool.reset();
+      Stats = DataFlowStats();
+      Stats.Function = func->getName().str();
+
+      {
+         PhaseTimer timer(CollectStats ? &Stats.EdgeInitTime : nullptr);
+         initializeMap(func, std::integral_constant<bool, Direction>());
+      }
+      Stats.EdgeInitTime -= Stats.IndexTime;
+      Stats.Instructions = IndexToInstr.size() - 1;
+      Stats.Edges = EdgeToInfo.size();
+      if (CollectStats)
+         VisitCounts.assign(IndexToInstr.size(), 0);
+
+      computeNodeOrder();
+      Solved.clear();
+      Solved.resize(IndexToInstr.size());
+      Demanded.clear();
+      Demanded.resize(IndexToInstr.size());
+      DemandWorklist.init(NodeRank);
+    }
+
+    /*
+     * Bring the solution of func up to date after edits, with the same result as solving
+     * the edited function from scratch. Changed lists the instructions that were inserted
+     * or whose operands, opcode or successors changed, Deleted the ones that were erased;
+     * they are only compared, never dereferenced. Instructions are renumbered, and only
+     * the nodes reachable from the changes are solved again, starting from bottom, with
+     * the plain flow functions. Info must provide a static renumber(Info *, old -> new
+     * index, Info * result) if instructions are inserted or deleted.
+     */
+    void reanalyze(Function * func, const std::vector<Instruction *> & Changed,
+                   const std::vector<Instruction *> & Deleted) {
+      // Only a full solution has final values outside the changed part.
+      if (Solved.size() != IndexToInstr.size() || !Solved.all() || IndexToInstr.empty() ||
+          InnerEdgesDropped) {
+         runWorklistAlgorithm(func);
+         return;
+      }
+
+      Stats = DataFlowStats();
+      Stats.Function = func->getName().str();
+      PhaseTimer timer(CollectStats ? &Stats.SolveTime : nullptr);
+      if (CollectStats)
+         VisitCounts.assign(IndexToInstr.size(), 0);
+
+      bool inPlace = Deleted.empty();
+      for (Instruction * I : Changed) {
+         if (I->isTerminator() || !InstrToIndex.count(I))
+            inPlace = false;
+      }
+      if (inPlace) {
+         if (NodeRank.size() != IndexToInstr.size())
+            computeNodeOrder();
+         Demanded.clear();
+         Demanded.resize(IndexToInstr.size());
+         DemandWorklist.init(NodeRank);
+         reanalyzeInPlace(Changed);
+      }
+      else
+         reanalyzeStructure(func, Changed, Deleted);
+
+      Stats.Instructions = IndexToInstr.size() - 1;
+      Stats.Edges = EdgeToInfo.size();
+      Pool.trim();
+      Solved.resize(IndexToInstr.size());
+      Solved.set();
+    }
+
+    /*
+     * The information on the edge src->dst (in analysis order), or null if there is none.
+     */
+    Info * queryEdge(Instruction * src, Instruction * dst) {
+      solveDemand(getInstrToIndex(src));
+      unsigned id = getEdgeId(getInstrToIndex(src), getInstrToIndex(dst));
+      return id == ~0U ? nullptr : getEdgeInfo(id);
+    }
+
+    /*
+     * What getInfoAfter(I) returns once the analysis is solved.
+     */
+    Info * queryInfoAfter(Instruction * I) {
+      solveDemand(getInstrToIndex(I));
+      return getInfoAfter(I);
+    }
+
+    /*
+     * Print the edges leaving the node of instruction index as print() does.
+     */
+    void printQuery(unsigned index, raw_ostream & OS) {
+      if (index == 0 || index >= IndexToInstr.size())
+         return;
+      solveDemand(index);
+      for (unsigned id = SuccOffsets[index]; id < SuccOffsets[index + 1]; id++) {
+         OS << "Edge " << EdgeSrc[id] << "->" "Edge " << SuccList[id] << ":";
+         getEdgeInfo(id)->print(OS);
+      }
+    }
+
+    /*
+     * Write the results as a record of the binary format of ResultStream: the function
+     * name, the number of instructions, the edges as (src, dst) pairs and their values
+     * as an EdgeValueWriter writes them, all numbers in ULEB128. With Nodes, only the
+     * edges leaving those nodes are written, solving them as printQuery() does.
+     */
+    void printBinary(raw_ostream & OS, const std::vector<unsigned> * Nodes = nullptr) {
+      PhaseTimer timer(CollectStats ? &Stats.PrintTime : nullptr);
+      std::vector<unsigned> ids;
+      if (Nodes == nullptr) {
+         for (unsigned id = 0; id < EdgeToInfo.size(); id++)
+            ids.push_back(id);
+      }
+      else {
+         for (unsigned index : *Nodes) {
+            if (index == 0 || index >= IndexToInstr.size())
+               continue;
+            solveDemand(index);
+            for (unsigned id = SuccOffsets[index]; id < SuccOffsets[index + 1]; id++)
+               ids.push_back(id);
+         }
+      }
+
+      encodeULEB128(Stats.Function.size(), OS);
+      OS << Stats.Function;
+      encodeULEB128(IndexToInstr.size() - 1, OS);
+      encodeULEB128(ids.size(), OS);
+      for (unsigned id : ids) {
+         encodeULEB128(EdgeSrc[id], OS);
+         encodeULEB128(SuccList[id], OS);
+      }
+      EdgeValueWriter<Info> values(OS);
+      for (unsigned id : ids)
+         writeEdgeValue(values, id);
+      releaseReplayedBlock();
+    }
+
+    Instruction * getIndexToInstr(unsigned i) {
+      return i < IndexToInstr.size() ? IndexToInstr[i] : nullptr;
+    }
+
+    unsigned getInstrToIndex(Instruction *i) {
+      return InstrToIndex.lookup(i);
+    }
+
+    /*
+     * The information on edge id, replaying its block first in boundary mode.
+     */
+    Info * getEdgeInfo(unsigned id) {
+      if (InnerEdgesDropped && isInnerEdge(id))
+         materializeBlock(NodeToBlock[EdgeSrc[id]]);
+      return EdgeToInfo[EdgeRep.empty() ? id : EdgeRep[id]];
+    }
+
+    /*
+     * The information on the first edge leaving the node of I, or null if I has no edges:
+     * for a forward analysis and an instruction other than a terminator, what holds
+     * right after I.
+     */
+    Info * getInfoAfter(Instruction * I) {
+      auto iter = InstrToIndex.find(I);
+      if (iter == InstrToIndex.end() || I == nullptr)
+         return nullptr;
+
+      unsigned index = iter->second;
+      if (SuccOffsets[index] == SuccOffsets[index + 1])
+         return nullptr;
+      return getEdgeInfo(SuccOffsets[index]);
+    }
+
+
+
+    /*
+     * This function implements the work list algorithm in the following steps:
+     * (1) Initialize info of each edge to bottom
+     * (2) Initialize the worklist
+     * (3) Compute until the worklist is empty
+     *
+     * Direction:
+     *   Implement the rest of the function.
+     *   You may not change anything before "// (2) Initialize the worklist".
+     */
+   void runWorklistAlgorithm(Function * func) {
+         OrderedWorklist worklist;
+
+         Pool.reset();
+         Stats = DataFlowStats();
+         Stats.Function = func->getName().str();
+
+         // (1) Initialize info of each edge to bottom
+         {
+            PhaseTimer timer(CollectStats ? &Stats.EdgeInitTime : nullptr);
+            initializeMap(func, std::integral_constant<bool, Direction>());
+         }
+         // The index assignment inside it was timed on its own.
+         Stats.EdgeInitTime -= Stats.IndexTime;
+         Stats.Instructions = IndexToInstr.size() - 1;
+         Stats.Edges = EdgeToInfo.size();
+
+         PhaseTimer timer(CollectStats ? &Stats.SolveTime : nullptr);
+         // Blocks never outnumber instructions, so this also covers block summary mode.
+         if (CollectStats)
+            VisitCounts.assign(IndexToInstr.size(), 0);
+
+         assert(EntryInstr != nullptr && "Entry instruction is null.");
+
+         computeNodeOrder();
+
+         if (BlockSummaryMode || BoundaryMode) {
+            runBlockWorklist(func);
+         }
+         else if (WeakTopologicalMode) {
+            runWeakTopologicalOrder();
+         }
+         else if (SparseMode) {
+            runSparseWorklist();
+         }
+         else if (DeltaSolver) {
+            (this->*DeltaSolver)();
+         }
+         else {
+            // (2) Initialize the work list, visiting nodes in reverse postorder
+            worklist.init(NodeRank);
+            unsigned node = 1;
+            for(inst_iterator I = inst_begin(func), E = inst_end(func); I != E; I++) {
+               countPush(worklist, node++);
+            }
+
+            // (3) Compute until the work list is empty
+            std::vector<unsigned> changed;
+            while(!worklist.empty()) {
+               unsigned n = worklist.pop();
+               countVisit(n);
+
+               changed.clear();
+               visitNode(n, changed);
+               for(unsigned dst : changed) {
+                  countPush(worklist, dst);
                }
-            } // end for
 
-         } // end while
+            } // end while
+         }
+
+         Pool.trim();
+
+         // Queries find everything solved.
+         Solved.clear();
+         Solved.resize(IndexToInstr.size(), true);
 
    } // end worklist
 };
 
 
 
+/*
+ * Module-level driver: run AnalyzeFunction(F, OS) for every function with a body in M on a
+ * pool of Threads worker threads (0 means one per hardware thread). The analyses only read
+ * the IR, and every function writes into its own buffer. The calling thread writes the
+ * buffers to Out in module order as they complete, so the output does not depend on
+ * scheduling and matches running the function pass over the module.
+ */
+template <class Body>
+void runOnFunctionsInParallel(Module & M, unsigned Threads, raw_ostream & Out, Body AnalyzeFunction) {
+   std::vector<Function *> funcs;
+   for (Function &F : M) {
+      if (!F.isDeclaration())
+         funcs.push_back(&F);
+   }
+
+   if (Threads == 0)
+      Threads = std::max(1u, std::thread::hardware_concurrency());
+   Threads = std::min<unsigned>(Threads, funcs.size());
+
+   std::vector<std::string> outputs(funcs.size());
+   std::vector<bool> done(funcs.size(), false);
+   std::atomic<unsigned> next(0);
+   std::mutex lock;
+   std::condition_variable finished;
+
+   auto worker = [&]() {
+      for (unsigned i = next++; i < funcs.size(); i = next++) {
+         std::string buffer;
+         raw_string_ostream OS(buffer);
+         AnalyzeFunction(*funcs[i], OS);
+         OS.flush();
+
+         std::lock_guard<std::mutex> guard(lock);
+         outputs[i].swap(buffer);
+         done[i] = true;
+         finished.notify_one();
+      }
+   };
+
+   std::vector<std::thread> pool;
+   for (unsigned t = 0; t < Threads; t++)
+      pool.emplace_back(worker);
+
+   for (unsigned i = 0; i < funcs.size(); i++) {
+      std::string output;
+      {
+         std::unique_lock<std::mutex> guard(lock);
+         finished.wait(guard, [&]() { return done[i]; });
+         output.swap(outputs[i]);
+      }
+      Out << output;
+   }
+
+   for (std::thread &t : pool)
+      t.join();
+}
+
+/*
+ * Results of an analysis kept in a directory across runs, one file per function, so that
+ * unchanged functions need not be solved again. An entry is named after the analysis and
+ * a hash of everything its results depend on: the function's IR, a variant chosen by the
+ * pass (e.g. a mode that changes the results) and Version, which must be bumped whenever
+ * the framework or an analysis changes what the results are or how they are encoded.
+ * Entries are written under a temporary name and renamed, so concurrent runs only see
+ * whole files. A lookup refreshes the entry's modification time, and prune() deletes the
+ * least recently used entries until the directory fits its size limit.
+ *
+ * A cache with an empty directory is disabled: nothing is hashed, found or stored.
+ */
+class ResultCache {
+      // Every file of the cache starts with this, so other files are never pruned.
+      static StringRef prefix() {
+         return "cse231-";
+      }
+
+      static StringRef magic() {
+         return StringRef("cse231-result\0", 14);
+      }
+
+      std::string Dir;
+      std::string Analysis;
+
+      std::string pathOf(StringRef Key) const {
+         SmallString<128> path(Dir);
+         sys::path::append(path, Key);
+         return path.str().str();
+      }
+
+   public:
+      enum : unsigned { Version = 2 };
+
+      ResultCache(StringRef Dir, StringRef Analysis) : Dir(Dir.str()), Analysis(Analysis.str()) {}
+
+      bool isEnabled() const {
+         return !Dir.empty();
+      }
+
+      /*
+       * The name of the entry for F under Variant, or "" if the cache is disabled.
+       */
+      std::string getKey(Function & F, StringRef Variant = "") const {
+         if (!isEnabled())
+            return "";
+
+         std::string text;
+         raw_string_ostream OS(text);
+         OS << Version << '\0' << Analysis << '\0' << Variant << '\0';
+         F.print(OS);
+         OS.flush();
+
+         MD5 hash;
+         hash.update(text);
+         MD5::MD5Result result;
+         hash.final(result);
+         SmallString<32> digest;
+         MD5::stringifyResult(result, digest);
+         return (Analysis + "-" + digest.str()).str();
+      }
+
+      /*
+       * Put the data of entry Key into Data. Returns false if there is no such entry.
+       */
+      bool lookup(StringRef Key, std::string & Data) const {
+         if (!isEnabled())
+            return false;
+
+         std::string path = pathOf(Key);
+         ErrorOr<std::unique_ptr<MemoryBuffer> > buffer = MemoryBuffer::getFile(path);
+         if (!buffer)
+            return false;
+         StringRef contents = (*buffer)->getBuffer();
+         if (!contents.startswith(magic()))
+            return false;
+         Data = contents.drop_front(magic().size()).str();
+
+         int fd;
+         if (!sys::fs::openFileForRead(path, fd)) {
+#if LLVM_VERSION_MAJOR >= 8
+            sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+#else
+            sys::fs::setLastModificationAndAccessTime(fd, std::chrono::system_clock::now());
+#endif
+            sys::Process::SafelyCloseFileDescriptor(fd);
+         }
+         return true;
+      }
+
+      /*
+       * Make Data the entry Key. Failures are ignored; the entry is just missing then.
+       */
+      void store(StringRef Key, StringRef Data) const {
+         if (!isEnabled() || sys::fs::create_directories(Dir))
+            return;
+
+         int fd;
+         SmallString<128> temp;
+         if (sys::fs::createUniqueFile(pathOf(prefix().str() + "tmp-%%%%%%%%%%%%"), fd, temp))
+            return;
+         {
+            raw_fd_ostream out(fd, /* shouldClose */ true);
+            out << magic() << Data;
+            out.close();
+            if (!out.has_error() && !sys::fs::rename(temp, pathOf(Key)))
+               return;
+            out.clear_error();
+         }
+         sys::fs::remove(temp);
+      }
+
+      /*
+       * Delete entries, least recently used first, until the entries of every analysis
+       * together take at most MaxBytes. 0 means no limit.
+       */
+      void prune(uint64_t MaxBytes) const {
+         if (!isEnabled() || MaxBytes == 0)
+            return;
+
+         struct Entry {
+            sys::TimePoint<> Time;
+            uint64_t Size;
+            std::string Path;
+         };
+         std::vector<Entry> entries;
+         uint64_t total = 0;
+         std::error_code error;
+         for (sys::fs::directory_iterator it(Dir, error), end; it != end && !error; it.increment(error)) {
+            if (!sys::path::filename(it->path()).startswith(prefix()))
+               continue;
+            sys::fs::file_status status;
+            if (sys::fs::status(it->path(), status) || !sys::fs::is_regular_file(status))
+               continue;
+            entries.push_back(Entry{status.getLastModificationTime(), status.getSize(), it->path()});
+            total += status.getSize();
+         }
+
+         std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.Time < b.Time;
+         });
+         for (unsigned i = 0; i < entries.size() && total > MaxBytes; i++) {
+            if (!sys::fs::remove(entries[i].Path))
+               total -= entries[i].Size;
+         }
+      }
+};
+
+/*
+ * Where a pass writes its results: a file, or stderr like print(), through a large buffer
+ * instead of one write per element. In binary format the stream starts with magic(), then
+ * Version and the analysis name (its length in ULEB128, then its bytes), and every
+ * function adds a record from printBinary(). tools/DecodeResults.cpp turns that back into
+ * the text print() writes.
+ */
+class ResultStream {
+      std::unique_ptr<raw_fd_ostream> Out;
+      bool Binary = false;
+
+   public:
+      enum : unsigned { Version = 2 };
+
+      static StringRef magic() {
+         return StringRef("cse231-results\0", 15);
+      }
+
+      /*
+       * Start writing to Path, or to stderr if Path is empty. Returns the error if the file
+       * cannot be created.
+       */
+      std::error_code open(StringRef Path, bool IsBinary, StringRef Analysis) {
+         std::error_code error;
+         if (Path.empty())
+            Out.reset(new raw_fd_ostream(2, /* shouldClose */ false));
+         else {
+#if LLVM_VERSION_MAJOR >= 9
+            Out.reset(new raw_fd_ostream(Path, error, sys::fs::OF_None));
+#else
+            Out.reset(new raw_fd_ostream(Path, error, sys::fs::F_None));
+#endif
+         }
+         if (error) {
+            Out->clear_error();
+            Out.reset();
+            return error;
+         }
+
+         Out->SetBufferSize(1 << 20);
+         Binary = IsBinary;
+         if (Binary) {
+            *Out << magic();
+            encodeULEB128(Version, *Out);
+            encodeULEB128(Analysis.size(), *Out);
+            *Out << Analysis;
+         }
+         return error;
+      }
+
+      bool isOpen() const {
+         return Out != nullptr;
+      }
+
+      raw_ostream & stream() {
+         return *Out;
+      }
+
+      bool isBinary() const {
+         return Binary;
+      }
+
+      /*
+       * Pass on what was written so far. The function passes do this after every function,
+       * so that their output on stderr stays in order with that of other passes.
+       */
+      void flush() {
+         Out->flush();
+      }
+
+      void close() {
+         if (!Out)
+            return;
+         Out->flush();
+         if (Out->has_error()) {
+            errs() << "error: cannot write the analysis results\n";
+            Out->clear_error();
+         }
+         Out.reset();
+      }
+};
+
+/*
+ * Append the stats of one run to File as a JSON line. Safe to call from several threads.
+ * If File cannot be opened or written, the error is reported on stderr once and the stats
+ * of the rest of the run are dropped.
+ */
+inline void appendStatsLine(const std::string & File, StringRef Analysis, const DataFlowStats & Stats) {
+   std::string line;
+   raw_string_ostream OS(line);
+   Stats.printJSON(OS, Analysis);
+   OS.flush();
+
+   static std::mutex lock;
+   static std::set<std::string> unwritable;
+   std::lock_guard<std::mutex> guard(lock);
+   if (unwritable.count(File))
+      return;
+   std::error_code error;
+#if LLVM_VERSION_MAJOR >= 9
+   raw_fd_ostream out(File, error, sys::fs::OF_Append);
+#else
+   raw_fd_ostream out(File, error, sys::fs::F_Append);
+#endif
+   if (!error) {
+      out << line;
+      out.close();
+      error = out.error();
+   }
+   if (error) {
+      out.clear_error();
+      errs() << "error: cannot write " << Analysis << " statistics to " << File << ": " << error.message() << "\n";
+      unwritable.insert(File);
+   }
 }
+
+}
+
 #endif // End LLVM_231DFA_H
@@ -0,0 +1,319 @@
+//===- AndersenSolver.h - Inclusion-based points-to constraint solver -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the flow-insensitive solver behind cse231-maypointto's Andersen
+// mode. Nodes are the ids of MayPointToInfo; the pass turns the transfer rules of its
+// instructions into constraints and reads one points-to set per node back.
+//
+// The solver works in waves: push the new part of every set along the copy edges in
+// topological order, then turn the new pointees of loaded and stored pointers into copy
+// edges. Cycle detection is online in that every new edge is checked against the order
+// as it is added: an edge that follows the order cannot close a cycle, and the next wave
+// keeps the order. Only an edge against it makes the next wave run Tarjan's algorithm
+// again, which collapses the cycles closed and orders the copy graph anew. Cycles are
+// collapsed there rather than on the spot, since the wave is still walking the edges
+// they would merge.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_ANDERSENSOLVER_H
+#define LLVM_TRANSFORMS_ANDERSENSOLVER_H
+
+#include "MayPointToInfo.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class AndersenSolver {
+
+   /*
+    * Cycle members are merged into one representative, which holds the set and edges
+    * of all of them.
+    */
+   std::vector<unsigned> Rep;
+   std::vector<PointsToSet> Pts;
+
+   // The part of Pts already sent along the copy edges, and the part whose load and
+   // store constraints have been turned into copy edges.
+   std::vector<PointsToSet> Sent;
+   std::vector<PointsToSet> Resolved;
+
+   // Copy edges n -> s (pts(s) includes pts(n)), the d with d = *n, the s with *n = s.
+   std::vector<SmallVector<unsigned, 4> > Succs;
+   std::vector<SmallVector<unsigned, 2> > Loads;
+   std::vector<SmallVector<unsigned, 2> > Stores;
+   DenseSet<std::pair<unsigned, unsigned> > CopyEdges;
+
+   // The place of each representative in the topological order of the last collapse, and
+   // whether a copy edge added since goes against it.
+   std::vector<unsigned> Position;
+   bool OrderBroken;
+
+   unsigned find(unsigned n) {
+      while (Rep[n] != n) {
+         Rep[n] = Rep[Rep[n]];
+         n = Rep[n];
+      }
+      return n;
+   }
+
+   static void noop(unsigned) {}
+
+   /*
+    * Add the copy edge src -> dst and give dst what src has so far, since the waves only
+    * send the rest. Returns whether dst grew.
+    */
+   bool addCopyEdge(unsigned src, unsigned dst) {
+      src = find(src);
+      dst = find(dst);
+      if (src == dst || !CopyEdges.insert(std::make_pair(src, dst)).second)
+         return false;
+
+      Succs[src].push_back(dst);
+      if (Position[dst] < Position[src])
+         OrderBroken = true;
+      return Pts[dst].unionWith(Pts[src], noop) != 0;
+   }
+
+   void merge(unsigned n, unsigned rep) {
+      Rep[n] = rep;
+      Pts[rep].unionWith(Pts[n], noop);
+      Succs[rep].append(Succs[n].begin(), Succs[n].end());
+      Loads[rep].append(Loads[n].begin(), Loads[n].end());
+      Stores[rep].append(Stores[n].begin(), Stores[n].end());
+
+      // Only what both sent along their edges, or resolved against their loads and stores,
+      // is done for the merged node.
+      Sent[rep] = PointsToSet::difference(Sent[rep], PointsToSet::difference(Sent[rep], Sent[n]));
+      Resolved[rep] = PointsToSet::difference(Resolved[rep], PointsToSet::difference(Resolved[rep], Resolved[n]));
+
+      Pts[n] = PointsToSet();
+      Sent[n] = PointsToSet();
+      Resolved[n] = PointsToSet();
+      Succs[n].clear();
+      Loads[n].clear();
+      Stores[n].clear();
+   }
+
+   /*
+    * Collapse the strongly connected components of the copy graph (Tarjan's algorithm,
+    * without recursion) and return the representatives in topological order.
+    */
+   std::vector<unsigned> collapseCycles() {
+      unsigned numNodes = Rep.size();
+      std::vector<unsigned> index(numNodes, 0);
+      std::vector<unsigned> low(numNodes, 0);
+      std::vector<bool> onStack(numNodes, false);
+      std::vector<unsigned> stack;
+      std::vector<std::pair<unsigned, unsigned> > calls;
+      std::vector<std::vector<unsigned> > components;
+      unsigned counter = 0;
+
+      for (unsigned root = 0; root < numNodes; root++) {
+         if (Rep[root] != root || index[root] != 0)
+            continue;
+
+         calls.push_back(std::make_pair(root, 0));
+         index[root] = low[root] = ++counter;
+         stack.push_back(root);
+         onStack[root] = true;
+
+         while (!calls.empty()) {
+            unsigned n = calls.back().first;
+            unsigned &next = calls.back().second;
+            if (next < Succs[n].size()) {
+               unsigned s = find(Succs[n][next++]);
+               if (index[s] == 0) {
+                  index[s] = low[s] = ++counter;
+                  stack.push_back(s);
+                  onStack[s] = true;
+                  calls.push_back(std::make_pair(s, 0));
+               }
+               else if (onStack[s]) {
+                  low[n] = std::min(low[n], index[s]);
+               }
+               continue;
+            }
+
+            calls.pop_back();
+            if (!calls.empty()) {
+               unsigned parent = calls.back().first;
+               low[parent] = std::min(low[parent], low[n]);
+            }
+            if (low[n] != index[n])
+               continue;
+
+            components.emplace_back();
+            unsigned member;
+            do {
+               member = stack.back();
+               stack.pop_back();
+               onStack[member] = false;
+               components.back().push_back(member);
+            } while (member != n);
+         }
+      }
+
+      // Components come out sinks first.
+      std::vector<unsigned> order;
+      order.reserve(components.size());
+      for (auto it = components.rbegin(); it != components.rend(); ++it) {
+         unsigned rep = it->back();
+         for (unsigned member : *it) {
+            if (member != rep)
+               merge(member, rep);
+         }
+         order.push_back(rep);
+      }
+
+      // Point the edges at representatives and drop duplicates and self loops.
+      for (unsigned n : order) {
+         SmallVector<unsigned, 4> &succs = Succs[n];
+         for (unsigned &s : succs)
+            s = find(s);
+         std::sort(succs.begin(), succs.end());
+         succs.erase(std::unique(succs.begin(), succs.end()), succs.end());
+         succs.erase(std::remove(succs.begin(), succs.end(), n), succs.end());
+      }
+
+      for (unsigned k = 0; k < order.size(); k++)
+         Position[order[k]] = k;
+      OrderBroken = false;
+      return order;
+   }
+
+   /*
+    * Send the unsent part of every set along the copy edges. In topological order one
+    * pass is enough.
+    */
+   void propagate(const std::vector<unsigned> &order) {
+      for (unsigned n : order) {
+         if (Pts[n].count() == Sent[n].count())
+            continue;
+
+         PointsToSet fresh = PointsToSet::difference(Pts[n], Sent[n]);
+         Sent[n] = Pts[n];
+         for (unsigned s : Succs[n])
+            Pts[s].unionWith(fresh, noop);
+      }
+   }
+
+   /*
+    * Turn the new pointees of loaded and stored pointers into copy edges. Returns whether
+    * any set grew, which calls for another wave.
+    */
+   bool resolveComplex(const std::vector<unsigned> &order) {
+      bool changed = false;
+      for (unsigned n : order) {
+         if (Loads[n].empty() && Stores[n].empty())
+            continue;
+         if (Pts[n].count() == Resolved[n].count())
+            continue;
+
+         PointsToSet fresh = PointsToSet::difference(Pts[n], Resolved[n]);
+         Resolved[n] = Pts[n];
+         for (unsigned x : fresh) {
+            for (unsigned d : Loads[n])
+               changed |= addCopyEdge(x, d);
+            for (unsigned s : Stores[n])
+               changed |= addCopyEdge(s, x);
+         }
+      }
+      return changed;
+   }
+
+public:
+
+   explicit AndersenSolver(unsigned numNodes = 0) {
+      reset(numNodes);
+   }
+
+   /*
+    * Drop all constraints and make room for nodes 0 .. numNodes-1.
+    */
+   void reset(unsigned numNodes) {
+      Rep.resize(numNodes);
+      for (unsigned n = 0; n < numNodes; n++)
+         Rep[n] = n;
+      Pts.assign(numNodes, PointsToSet());
+      Sent.assign(numNodes, PointsToSet());
+      Resolved.assign(numNodes, PointsToSet());
+      Succs.assign(numNodes, SmallVector<unsigned, 4>());
+      Loads.assign(numNodes, SmallVector<unsigned, 2>());
+      Stores.assign(numNodes, SmallVector<unsigned, 2>());
+      CopyEdges.clear();
+      Position.assign(numNodes, 0);
+      OrderBroken = false;
+   }
+
+   unsigned numNodes() const {
+      return Rep.size();
+   }
+
+   /*
+    * pointer = &object
+    */
+   void addAddressOf(unsigned pointer, unsigned object) {
+      Pts[find(pointer)].test_and_set(object);
+   }
+
+   /*
+    * dst = src
+    */
+   void addCopy(unsigned dst, unsigned src) {
+      src = find(src);
+      dst = find(dst);
+      if (src != dst && CopyEdges.insert(std::make_pair(src, dst)).second)
+         Succs[src].push_back(dst);
+   }
+
+   /*
+    * dst = *src
+    */
+   void addLoad(unsigned dst, unsigned src) {
+      Loads[find(src)].push_back(dst);
+   }
+
+   /*
+    * *dst = src
+    */
+   void addStore(unsigned dst, unsigned src) {
+      Stores[find(dst)].push_back(src);
+   }
+
+   void solve() {
+      std::vector<unsigned> order = collapseCycles();
+      while (true) {
+         propagate(order);
+         if (!resolveComplex(order))
+            break;
+         if (OrderBroken)
+            order = collapseCycles();
+      }
+   }
+
+   /*
+    * The points-to set of node n, after solve().
+    */
+   const PointsToSet & pointsTo(unsigned n) const {
+      while (Rep[n] != n)
+         n = Rep[n];
+      return Pts[n];
+   }
+};
+
+}
+
+#endif // End LLVM_TRANSFORMS_ANDERSENSOLVER_H
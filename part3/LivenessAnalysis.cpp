@@ -7,6 +7,8 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <deque>
@@ -18,58 +20,77 @@
 using namespace llvm;
 using namespace std;
 
+static cl::opt<bool> BlockSummary("liveness-block-summary",
+                                  cl::desc("Iterate cse231-liveness over basic block summaries"),
+                                  cl::init(false));
+static cl::opt<bool> WeakTopological("liveness-wto",
+                                     cl::desc("Iterate cse231-liveness in weak topological order"),
+                                     cl::init(false));
+static cl::opt<bool> Delta("liveness-delta",
+                           cl::desc("Propagate only newly added cse231-liveness facts"),
+                           cl::init(false));
+static cl::opt<bool> Intern("liveness-intern",
+                            cl::desc("Keep one shared copy of each distinct cse231-liveness value"),
+                            cl::init(false));
+static cl::opt<bool> Boundary("liveness-boundary",
+                              cl::desc("Keep cse231-liveness facts only between basic blocks and replay blocks to print them"),
+                              cl::init(false));
+static cl::opt<unsigned> Threads("liveness-threads",
+                                 cl::desc("Worker threads for cse231-liveness-module (0: one per hardware thread)"),
+                                 cl::init(0));
+static cl::list<unsigned> QueryPoints("liveness-query",
+                                     cl::desc("Print only the edges leaving these instructions, solving just what they depend on"),
+                                     cl::value_desc("index"),
+                                     cl::CommaSeparated);
+static cl::opt<std::string> OutputFile("liveness-output",
+                                       cl::desc("Write the cse231-liveness results to this file instead of stderr"),
+                                       cl::value_desc("filename"),
+                                       cl::init(""));
+static cl::opt<bool> BinaryOutput("liveness-binary",
+                                  cl::desc("Write the cse231-liveness results in the compact binary format read by tools/DecodeResults.cpp"),
+                                  cl::init(false));
+static cl::opt<std::string> CacheDir("liveness-cache-dir",
+                                     cl::desc("Reuse the cse231-liveness results of unchanged functions kept in this directory"),
+                                     cl::value_desc("directory"),
+                                     cl::init(""));
+static cl::opt<unsigned> CacheSize("liveness-cache-size",
+                                   cl::desc("Size limit of -liveness-cache-dir in MB, least recently used results go first (0: no limit)"),
+                                   cl::init(256));
+static cl::opt<std::string> StatsFile("liveness-stats",
+                                     cl::desc("Append per-function cse231-liveness statistics to this file as JSON lines"),
+                                     cl::value_desc("filename"),
+                                     cl::init(""));
+
+
+/*
+ * Sets of instruction indices, kept as a bit vector over the framework's index space.
+ */
+typedef BitVectorInfo LivenessInfo;
 
-class LivenessInfo : public Info {
 
+template <class Info, bool Direction>
+class LivenessAnalysis : public DataFlowAnalysis<Info, Direction, LivenessAnalysis<Info, Direction> > {
 
-public:
-   vector<unsigned> v_info;
-
-   void print() {
-      for(unsigned v : v_info) {
-         errs() << v << "|";
-      }
-      errs() << "\n";
-   }
-
-   void removeInfo(unsigned i) {
-      v_info.erase(std::remove(v_info.begin(), v_info.end(), i), v_info.end());
-   }
-
-   void addInfo(unsigned i) {
-      v_info.push_back(i);
-      sort(v_info.begin(), v_info.end());
-      v_info.erase(std::unique(v_info.begin(), v_info.end()), v_info.end());
-   }
-
-   static bool equals(LivenessInfo *info1, LivenessInfo *info2) {
-      return info1->v_info == info2->v_info;
-   }
-
-
-   static LivenessInfo* join(LivenessInfo *info1, LivenessInfo *info2, LivenessInfo *result) {
-    
-      if(result == NULL || info1 == NULL || info2 == NULL) return NULL;
-
-      result->v_info.reserve(info1->v_info.size() + info2->v_info.size());
-      result->v_info.insert(result->v_info.end(), info1->v_info.begin(), info1->v_info.end());
-      result->v_info.insert(result->v_info.end(), info2->v_info.begin(), info2->v_info.end());
-
-      sort(result->v_info.begin(), result->v_info.end());
-      result->v_info.erase(std::unique(result->v_info.begin(), result->v_info.end()), result->v_info.end());
-      return result;
-   }   
-
-};
+   typedef DataFlowAnalysis<Info, Direction, LivenessAnalysis<Info, Direction> > Base;
+   friend Base;
 
+   private:
 
-template <class Info, bool Direction>
-class LivenessAnalysis : public DataFlowAnalysis<Info, Direction> {
+      /*
+       * Per-block transfer summary for the non-phi instructions:
+       * live-out = (live-in - Kill) U Gen, in backward order.
+       */
+      struct BlockSummary {
+         Info Kill;
+         Info Gen;
+         Info PhiDefs;
+         bool HasPhi;
+      };
 
-   private:
+      DenseMap<BasicBlock *, BlockSummary> Summaries;
 
       void initializeForwardMap(Function * func) {
-         DataFlowAnalysis<Info, Direction>::initializeForwardMap(func);
+         Base::initializeForwardMap(func);
       }
 
       void initializeBackwardMap(Function * func) {
@@ -93,6 +114,26 @@ class LivenessAnalysis : public DataFlowAnalysis<Info, Direction> {
          return 2;
       }
 
+      /*
+       * Add the values the phi nodes of BB take when control comes from label.
+       */
+      void addPhiUses(BasicBlock * BB, BasicBlock * label, Info * info) {
+         for(auto ib = BB->begin(), ie = BB->end(); ib != ie; ib++) {
+            if(isa<PHINode>(&*ib)) {
+               PHINode *pn = llvm::dyn_cast<PHINode>(&*ib);
+
+               for(unsigned index = 0; index < pn->getNumIncomingValues(); index++) {
+                  if(label == pn->getIncomingBlock(index)) {
+                     Instruction *instr = dyn_cast<Instruction>(pn->getIncomingValue(index));
+                     if(instr != NULL) {
+                        info->addInfo(this->getInstrToIndex(instr));
+                     }
+                  }
+               }
+            }
+         }
+      }
+
       void flowfunction(Instruction * I,
                         std::vector<unsigned> & IncomingEdges,
                         std::vector<unsigned> & OutgoingEdges,
@@ -100,13 +141,12 @@ class LivenessAnalysis : public DataFlowAnalysis<Info, Direction> {
 
          if(I == NULL) return;
 
-         Info *newInfo = new Info();
-
          unsigned index = this->getInstrToIndex(I);
-         for(auto i : IncomingEdges) {
-            LivenessInfo * oldInfo = this->getEdgeToInfo(make_pair(i, index));
-            LivenessInfo::join(newInfo, oldInfo, newInfo);
-         }
+
+         Info *in = this->joinIncoming(index, IncomingEdges);
+         Info *newInfo = this->allocateInfo();
+         *newInfo = *in;
+         this->discardInfo(in);
 
          unsigned instrType = getInstrType(I);
          int to = I->getNumOperands();
@@ -150,24 +190,11 @@ class LivenessAnalysis : public DataFlowAnalysis<Info, Direction> {
 
             if(instrType == 3) {
 
-               Info *tempInfo = new Info();
+               Info *tempInfo = this->allocateInfo();
                *tempInfo = *newInfo;
-               
-               for(auto ib = I->getParent()->begin(), ie = I->getParent()->end(); ib != ie; ib++) {
-                  if(isa<PHINode>(&*ib)) {
-                     PHINode *pn = llvm::dyn_cast<PHINode>(&*ib);   
-                     BasicBlock *label = (this->getIndexToInstr(OutgoingEdges[i]))->getParent();
-                     
-                     for(unsigned index = 0; index < pn->getNumIncomingValues(); index++) {
-                        if(label == pn->getIncomingBlock(index)) {
-                           Instruction *instr = dyn_cast<Instruction>(pn->getIncomingValue(index));
-                           if(instr != NULL) {
-                              tempInfo->addInfo(this->getInstrToIndex(instr));
-                           }
-                        }
-                     }
-                  }
-               }
+
+               BasicBlock *label = (this->getIndexToInstr(OutgoingEdges[i]))->getParent();
+               addPhiUses(I->getParent(), label, tempInfo);
                Infos.push_back(tempInfo);
             }
             else {
@@ -176,34 +203,231 @@ class LivenessAnalysis : public DataFlowAnalysis<Info, Direction> {
          
          }
 
+         // Phi nodes hand out per-edge copies, so newInfo itself was only scratch.
+         if(instrType == 3) {
+            this->discardInfo(newInfo);
+         }
+
       } // end flowfunction
 
+      /*
+       * The uses, including the per-edge phi uses, were added on the first visit,
+       * so the new facts only lose the definitions of I (or of all phis of its block).
+       */
+      bool deltaflowfunction(Instruction * I,
+                             Info * In,
+                             Info * Delta,
+                             std::vector<unsigned> & OutgoingEdges,
+                             std::vector<Info *> & Infos) {
+
+         Info *newInfo = this->allocateInfo();
+         *newInfo = *Delta;
+
+         switch(getInstrType(I)) {
+            case 1:
+               newInfo->removeInfo(this->getInstrToIndex(I));
+               break;
+
+            case 3:
+               for(auto ib = I->getParent()->begin(), ie = I->getParent()->end(); ib != ie; ib++) {
+                  Instruction *instr = &*ib;
+                  if(isa<PHINode>(instr)) {
+                     newInfo->removeInfo(this->getInstrToIndex(instr));
+                  }
+               }
+               break;
+         }
+
+         for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
+            Infos.push_back(newInfo);
+         }
+         return true;
+      } // end deltaflowfunction
+
+      /*
+       * Each non-phi instruction maps X to (X U uses) - def, which composes into a single
+       * (Kill, Gen) pair for the block. The phi nodes then kill their own definitions and
+       * add the operands flowing in from each predecessor, as in flowfunction.
+       */
+      bool blockflowfunction(BasicBlock * BB,
+                             Info * In,
+                             std::vector<unsigned> & OutgoingEdges,
+                             std::vector<Info *> & Infos) {
+
+         auto it = Summaries.find(BB);
+         if(it == Summaries.end()) {
+            BlockSummary summary;
+            summary.HasPhi = isa<PHINode>(&BB->front());
+
+            for(auto ib = BB->rbegin(), ie = BB->rend(); ib != ie; ib++) {
+               Instruction *I = &*ib;
+               unsigned index = this->getInstrToIndex(I);
+               if(isa<PHINode>(I)) {
+                  summary.PhiDefs.addInfo(index);
+                  continue;
+               }
+
+               for(unsigned from = 0; from < I->getNumOperands(); from++) {
+                  Instruction *instr = dyn_cast<Instruction>(I->getOperand(from));
+                  if(instr != NULL) {
+                     summary.Gen.addInfo(this->getInstrToIndex(instr));
+                  }
+               }
+               if(getInstrType(I) == 1) {
+                  summary.Gen.removeInfo(index);
+                  summary.Kill.addInfo(index);
+               }
+            }
+            it = Summaries.insert(make_pair(BB, summary)).first;
+         }
+         BlockSummary &summary = it->second;
+
+         Info *newInfo = this->allocateInfo();
+         LivenessInfo::subtract(In, &summary.Kill, newInfo);
+         LivenessInfo::join(newInfo, &summary.Gen, newInfo);
+
+         if(!summary.HasPhi) {
+            for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
+               Infos.push_back(newInfo);
+            }
+            return true;
+         }
+
+         LivenessInfo::subtract(newInfo, &summary.PhiDefs, newInfo);
+         for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
+            Info *tempInfo = this->allocateInfo();
+            *tempInfo = *newInfo;
+
+            BasicBlock *label = (this->getIndexToInstr(OutgoingEdges[i]))->getParent();
+            addPhiUses(BB, label, tempInfo);
+            Infos.push_back(tempInfo);
+         }
+         this->discardInfo(newInfo);
+         return true;
+      } // end blockflowfunction
+
    public:
-      LivenessAnalysis(Info &bottom, Info &initState) : DataFlowAnalysis<Info, Direction>(bottom, initState) {}
+      LivenessAnalysis(Info &bottom, Info &initState) : Base(bottom, initState) {}
 
 };
 
 
 namespace {
+   /*
+    * Run the analysis on F and print its results to OS.
+    */
+   void analyzeFunction(Function &F, raw_ostream &OS) {
+      LivenessInfo bott;
+      LivenessInfo init;
+
+      LivenessAnalysis<LivenessInfo, false> analysis(bott, init);
+      analysis.setBlockSummaryMode(BlockSummary);
+      analysis.setWeakTopologicalOrder(WeakTopological);
+      analysis.setDeltaMode(Delta);
+      analysis.setInterning(Intern);
+      analysis.setBoundaryMode(Boundary);
+      analysis.setCollectStats(!StatsFile.empty());
+
+      ResultCache cache(CacheDir, "cse231-liveness");
+      std::string key = cache.getKey(F);
+      std::string data;
+      bool cached = cache.lookup(key, data) && analysis.readResults(&F, data);
+
+      if (QueryPoints.empty()) {
+         if (!cached) {
+            analysis.runWorklistAlgorithm(&F);
+            if (cache.isEnabled())
+               cache.store(key, analysis.writeResults());
+         }
+         if (BinaryOutput)
+            analysis.printBinary(OS);
+         else
+            analysis.print(OS);
+      }
+      else {
+         if (!cached)
+            analysis.prepareQueries(&F);
+         if (BinaryOutput) {
+            std::vector<unsigned> points(QueryPoints.begin(), QueryPoints.end());
+            analysis.printBinary(OS, &points);
+         }
+         else {
+            for (unsigned index : QueryPoints)
+               analysis.printQuery(index, OS);
+         }
+      }
+
+      if (!StatsFile.empty())
+         appendStatsLine(StatsFile, "cse231-liveness", analysis.getStats());
+   }
+
+   /*
+    * Open Results where the command line asks. Returns false, after reporting why on stderr,
+    * if the file cannot be created; the pass then analyzes nothing.
+    */
+   bool openResults(ResultStream &Results) {
+      if (std::error_code error = Results.open(OutputFile, BinaryOutput, "cse231-liveness")) {
+         errs() << "error: cannot write cse231-liveness results to " << OutputFile << ": " << error.message() << "\n";
+         return false;
+      }
+      return true;
+   }
+
    struct LivenessAnalysisPass : public FunctionPass {
       public:
          static char ID;
          LivenessAnalysisPass() : FunctionPass(ID) {}
-         bool runOnFunction(Function &F) override { 
-            LivenessInfo *bott = new LivenessInfo();
-            LivenessInfo *init = new LivenessInfo();
 
-            LivenessAnalysis<LivenessInfo, false> analysis(*bott, *init);
+         bool doInitialization(Module &M) override {
+            openResults(Results);
+            return false;
+         }
 
-            analysis.runWorklistAlgorithm(&F);
-            analysis.print();
+         bool runOnFunction(Function &F) override { 
+            if (!Results.isOpen())
+               return false;
+            analyzeFunction(F, Results.stream());
+            Results.flush();
+            return false;
+         }
+
+         bool doFinalization(Module &M) override {
+            Results.close();
+            ResultCache(CacheDir, "cse231-liveness").prune((uint64_t)CacheSize << 20);
             return false;
          }
+
+      private:
+         ResultStream Results;
    }; 
+
+   /*
+    * Analyzes all functions of the module concurrently, printing them in module order.
+    */
+   struct LivenessModulePass : public ModulePass {
+      public:
+         static char ID;
+         LivenessModulePass() : ModulePass(ID) {}
+         bool runOnModule(Module &M) override {
+            ResultStream results;
+            if (!openResults(results))
+               return false;
+            runOnFunctionsInParallel(M, Threads, results.stream(), analyzeFunction);
+            results.close();
+            ResultCache(CacheDir, "cse231-liveness").prune((uint64_t)CacheSize << 20);
+            return false;
+         }
+   };
 }
 
 char LivenessAnalysisPass::ID = 0;
 static RegisterPass<LivenessAnalysisPass> X("cse231-liveness",
                                             "Developed to test LLVM and docker",
                                             false /* Only looks at CFG */,
-                                            false /* Analysis Pass */);
\ No newline at end of file
+                                            false /* Analysis Pass */);
+
+char LivenessModulePass::ID = 0;
+static RegisterPass<LivenessModulePass> Y("cse231-liveness-module",
+                                          "Runs cse231-liveness on all functions in parallel",
+                                          false /* Only looks at CFG */,
+                                          false /* Analysis Pass */);
@@ -1,16 +1,28 @@
 #include "231DFA.h"
+#include "AndersenSolver.h"
+#include "MayPointToInfo.h"
+#include "SteensgaardSolver.h"
 
 #include "llvm/Pass.h"
 #include "llvm/InitializePasses.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ValueMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <deque>
 #include <map>
+#include <memory>
 #include <utility>
 #include <vector>
 #include <algorithm>
@@ -18,67 +30,64 @@
 using namespace llvm;
 using namespace std;
 
+static cl::opt<bool> WeakTopological("maypointto-wto",
+                                     cl::desc("Iterate cse231-maypointto in weak topological order"),
+                                     cl::init(false));
+static cl::opt<bool> Sparse("maypointto-sparse",
+                            cl::desc("Solve cse231-maypointto only over pointer instructions, stores and joins"),
+                            cl::init(false));
+static cl::opt<bool> Delta("maypointto-delta",
+                           cl::desc("Propagate only newly added cse231-maypointto facts"),
+                           cl::init(false));
+static cl::opt<bool> Intern("maypointto-intern",
+                            cl::desc("Keep one shared copy of each distinct cse231-maypointto value"),
+                            cl::init(false));
+static cl::opt<bool> Boundary("maypointto-boundary",
+                              cl::desc("Keep cse231-maypointto facts only between basic blocks and replay blocks to print them"),
+                              cl::init(false));
+static cl::opt<bool> FlowInsensitive("maypointto-andersen",
+                                     cl::desc("Solve cse231-maypointto flow-insensitively and report that result on every edge"),
+                                     cl::init(false));
+static cl::opt<bool> FlowInsensitiveSeed("maypointto-andersen-seed",
+                                         cl::desc("Skip the instructions a flow-insensitive pre-analysis shows cannot add cse231-maypointto facts"),
+                                         cl::init(false));
+static cl::opt<bool> Unification("maypointto-steensgaard",
+                                 cl::desc("Solve cse231-maypointto by unification and report that result on every edge"),
+                                 cl::init(false));
+static cl::list<std::string> FlowSensitiveOnly("maypointto-flow-sensitive",
+                                               cl::desc("Functions that keep the flow-sensitive cse231-maypointto under -maypointto-andersen or -maypointto-steensgaard"),
+                                               cl::value_desc("function"),
+                                               cl::CommaSeparated);
+static cl::opt<unsigned> Threads("maypointto-threads",
+                                 cl::desc("Worker threads for cse231-maypointto-module (0: one per hardware thread)"),
+                                 cl::init(0));
+static cl::list<unsigned> QueryPoints("maypointto-query",
+                                     cl::desc("Print only the edges leaving these instructions, solving just what they depend on"),
+                                     cl::value_desc("index"),
+                                     cl::CommaSeparated);
+static cl::opt<std::string> OutputFile("maypointto-output",
+                                       cl::desc("Write the cse231-maypointto results to this file instead of stderr"),
+                                       cl::value_desc("filename"),
+                                       cl::init(""));
+static cl::opt<bool> BinaryOutput("maypointto-binary",
+                                  cl::desc("Write the cse231-maypointto results in the compact binary format read by tools/DecodeResults.cpp"),
+                                  cl::init(false));
+static cl::opt<std::string> CacheDir("maypointto-cache-dir",
+                                     cl::desc("Reuse the cse231-maypointto results of unchanged functions kept in this directory"),
+                                     cl::value_desc("directory"),
+                                     cl::init(""));
+static cl::opt<unsigned> CacheSize("maypointto-cache-size",
+                                   cl::desc("Size limit of -maypointto-cache-dir in MB, least recently used results go first (0: no limit)"),
+                                   cl::init(256));
+static cl::opt<std::string> StatsFile("maypointto-stats",
+                                     cl::desc("Append per-function cse231-maypointto statistics to this file as JSON lines"),
+                                     cl::value_desc("filename"),
+                                     cl::init(""));
+
 
 #define DEBUG_INFO 0
 #define DEBUG_FLOW 0
 
-typedef pair<char, unsigned> pointerInfo_t;
-
-
-class MayPointToInfo : public Info {
-
-
-public:
-
-   map<pointerInfo_t, vector<pointerInfo_t>> info;
-
-   void print() {
-      for(auto &pointer : info) {
-         errs() << pointer.first.first << pointer.first.second << "->(";
-         for(auto &pointee : pointer.second) {
-            errs() << pointee.first << pointee.second << "/";
-         }
-         errs() << ")|";
-      }
-      errs() << "\n";
-   }
-
-   void addInfo(pointerInfo_t pointer, pointerInfo_t pointee) {
-      auto iter = info.find(pointer);
-      if(iter != info.end()) {
-         iter->second.push_back(pointee);
-         sort(iter->second.begin(), iter->second.end());
-         iter->second.erase(unique(iter->second.begin(), iter->second.end()), iter->second.end());
-      }
-      else {
-         info[pointer].push_back(pointee);
-      }
-   }
-
-   static bool equals(MayPointToInfo *info1, MayPointToInfo *info2) {
-       auto lhs = info1->info;
-       auto rhs = info2->info;
-
-       return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
-   }
-
-
-   static MayPointToInfo* join(MayPointToInfo *info1, MayPointToInfo *info2, MayPointToInfo *result) {
-      if(result == NULL || info1 == NULL || info2 == NULL) return result;
-
-      result->info.insert(info1->info.begin(), info1->info.end());
-      for(auto val : info2->info) {
-         for(auto pointee : val.second) {
-            result->addInfo(val.first, pointee);
-         }
-      }
-
-      return result;
-   }   
-
-
-};
-
 #define ALLOCA        1
 #define BITCAST       2
 #define GETELEMENTPTR 3
@@ -89,12 +98,21 @@ public:
 #define OTHER         8
 
 template <class Info, bool Direction>
-class MayPointToAnalysis : public DataFlowAnalysis<Info, Direction> {
+class MayPointToAnalysis : public DataFlowAnalysis<Info, Direction, MayPointToAnalysis<Info, Direction> > {
+
+   typedef DataFlowAnalysis<Info, Direction, MayPointToAnalysis<Info, Direction> > Base;
+   friend Base;
 
    private:
 
+      AndersenSolver Andersen;
+
+      // With a flow-insensitive seed, the instructions that can add facts at all.
+      BitVector Generates;
+      bool Seeded = false;
+
       void initializeForwardMap(Function * func) {
-         DataFlowAnalysis<Info, Direction>::initializeForwardMap(func);
+         Base::initializeForwardMap(func);
       }
 
       void initializeBackwardMap(Function * func) {
@@ -131,6 +149,98 @@ class MayPointToAnalysis : public DataFlowAnalysis<Info, Direction> {
          return !I->getType()->isPointerTy() && strcmp(I->getOpcodeName(), "store");
       }
 
+      /*
+       * Whether flowfunction can add facts at I. It forwards its input for everything but
+       * pointers and stores, and, with a flow-insensitive seed, for the instructions whose
+       * facts are empty in the flow-insensitive solution, which includes all of them.
+       */
+      bool generates(Instruction *I) {
+         if(isNotPointerOrStore(I)) return false;
+         return !Seeded || Generates.test(this->getInstrToIndex(I));
+      }
+
+      bool isRelevant(Instruction *I) {
+         return generates(I);
+      }
+
+      /*
+       * The rules of flowfunction at I as constraints on one points-to graph for the whole
+       * function. Solver is AndersenSolver or SteensgaardSolver. Operands that are not
+       * instructions have no node of their own and point to nothing in flowfunction, so
+       * their constraints are left out rather than tied to a node they would all share.
+       */
+      template <class Solver>
+      void addConstraints(Instruction *I, Solver &solver) {
+         unsigned index = this->getInstrToIndex(I);
+         unsigned Ri = Info::regNode(index);
+         unsigned Rv, Rp;
+
+         switch(getInstrType(I)) {
+            case ALLOCA:
+               solver.addAddressOf(Ri, Info::memNode(index));
+               break;
+
+            case BITCAST:
+            case GETELEMENTPTR:
+               if(operandNode(I->getOperand(0), Rv))
+                  solver.addCopy(Ri, Rv);
+               break;
+
+            case LOAD:
+               if(operandNode(I->getOperand(0), Rp))
+                  solver.addLoad(Ri, Rp);
+               break;
+
+            case STORE:
+               if(operandNode(I->getOperand(0), Rv) && operandNode(I->getOperand(1), Rp))
+                  solver.addStore(Rp, Rv);
+               break;
+
+            case SELECT:
+               if(operandNode(I->getOperand(1), Rv))
+                  solver.addCopy(Ri, Rv);
+               if(operandNode(I->getOperand(2), Rv))
+                  solver.addCopy(Ri, Rv);
+               break;
+
+            case PHI:
+               for(auto ib = I->getParent()->begin(), ie = I->getParent()->end(); ib != ie; ib++) {
+                  if(isa<PHINode>(&*ib)) {
+                     PHINode *pn = llvm::dyn_cast<PHINode>(&*ib);
+                     for(unsigned ii = 0; ii < pn->getNumIncomingValues(); ii++) {
+                        Instruction *instr = dyn_cast<Instruction>(pn->getOperand(ii));
+                        if(instr != NULL) {
+                           solver.addCopy(Ri, regNode(instr));
+                        }
+                     }
+                  }
+               }
+               break;
+
+            default:
+               break;
+         }
+      }
+
+      /*
+       * Solve the flow-insensitive analysis of func: one points-to graph that holds at
+       * every program point and includes all the facts flowfunction finds at any of them.
+       */
+      template <class Solver>
+      unsigned solveFlowInsensitive(Function *func, Solver &solver) {
+         this->indexInstructions(func);
+         unsigned numInstrs = std::distance(inst_begin(func), inst_end(func));
+
+         solver.reset(Info::memNode(numInstrs + 1));
+         for(inst_iterator I = inst_begin(func), E = inst_end(func); I != E; ++I) {
+            if(!isNotPointerOrStore(&*I)) {
+               addConstraints(&*I, solver);
+            }
+         }
+         solver.solve();
+         return numInstrs;
+      }
+
       void flowfunction(Instruction * I,
                         std::vector<unsigned> & IncomingEdges,
                         std::vector<unsigned> & OutgoingEdges,
@@ -141,147 +251,655 @@ class MayPointToAnalysis : public DataFlowAnalysis<Info, Direction> {
 
          if(I == NULL) return;
 
-         Info *newInfo = new Info();
-
          unsigned index = this->getInstrToIndex(I);
 
-         for(auto i : IncomingEdges) {
-            MayPointToInfo * oldInfo = this->getEdgeToInfo(make_pair(i, index));
-            MayPointToInfo::join(newInfo, oldInfo, newInfo);
-         }
+         Info *in = this->joinIncoming(index, IncomingEdges);
 
-        
-         if(isNotPointerOrStore(I)) { 
+         // Nothing changes: pass the incoming value on without copying it.
+         if(!generates(I)) { 
             for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
-               Infos.push_back(newInfo);
+               Infos.push_back(in);
             }
             return;
          }
 
+         Info *newInfo = this->allocateInfo();
+         *newInfo = *in;
+         this->discardInfo(in);
+
+         unsigned Ri = Info::regNode(index);
          unsigned instrType = getInstrType(I);
          switch(instrType) {
             case ALLOCA:   
-               newInfo->addInfo(make_pair('R', index), make_pair('M', index));
+               newInfo->addInfo(Ri, Info::memNode(index));
                break;
 
             case BITCAST:
-            case GETELEMENTPTR: {
-                  unsigned i = this->getInstrToIndex(dyn_cast<Instruction>(I->getOperand(0)));
-                  if(newInfo->info.find(make_pair('R', i)) != newInfo->info.end()) {
-                     for(auto x : newInfo->info[make_pair('R', i)]) {
-                        newInfo->addInfo(make_pair('R', index), x);
-                     }
-                  }
-               }
+            case GETELEMENTPTR:
+               addPointees(newInfo, Ri, newInfo, regNode(I->getOperand(0)));
                break;
 
             case LOAD: {
-                  pointerInfo_t Rp = make_pair('R', this->getInstrToIndex(dyn_cast<Instruction>(I->getOperand(0))));
-                  if(newInfo->info.find(Rp) != newInfo->info.end()) {
-                     for(auto x : newInfo->info[Rp]) {
-                        if(newInfo->info.find(x) != newInfo->info.end()) {
-                           for(auto y : newInfo->info[x]) {
-                              newInfo->addInfo(make_pair('R', index), y);
-                           }
-                        }
+                  const typename Info::PointsToSet *pointees = newInfo->pointsTo(regNode(I->getOperand(0)));
+                  if(pointees != NULL) {
+                     for(unsigned x : *pointees) {
+                        addPointees(newInfo, Ri, newInfo, x);
                      }
                   }
                }
                break;
 
             case STORE: {
-                  pointerInfo_t Rv = make_pair('R', this->getInstrToIndex(dyn_cast<Instruction>(I->getOperand(0))));
-                  pointerInfo_t Rp = make_pair('R', this->getInstrToIndex(dyn_cast<Instruction>(I->getOperand(1))));
-                  if(newInfo->info.find(Rv) != newInfo->info.end()) {
-                     for(auto x : newInfo->info[Rv]) {
-                        if(newInfo->info.find(Rp) != newInfo->info.end()) {
-                           for(auto y : newInfo->info[Rp]) {
-                              newInfo->addInfo(y, x);
-                           }
-                        }
+                  const typename Info::PointsToSet *values = newInfo->pointsTo(regNode(I->getOperand(0)));
+                  const typename Info::PointsToSet *pointers = newInfo->pointsTo(regNode(I->getOperand(1)));
+                  if(values != NULL && pointers != NULL) {
+                     for(unsigned y : *pointers) {
+                        newInfo->addPointsTo(y, *values);
                      }
                   }
                }
                break;
 
-            case SELECT: {
-                  pointerInfo_t Ri = make_pair('R', index);
-                  pointerInfo_t Rt = make_pair('R', this->getInstrToIndex(dyn_cast<Instruction>(I->getOperand(1))));
-                  pointerInfo_t Rf = make_pair('R', this->getInstrToIndex(dyn_cast<Instruction>(I->getOperand(2))));
-                  if(newInfo->info.find(Rt) != newInfo->info.end()) {
-                     for(auto x : newInfo->info[Rt]) {
-                        newInfo->addInfo(Ri, x);
+            case SELECT:
+               addPointees(newInfo, Ri, newInfo, regNode(I->getOperand(1)));
+               addPointees(newInfo, Ri, newInfo, regNode(I->getOperand(2)));
+               break;
+
+            case PHI:
+               for(auto ib = I->getParent()->begin(), ie = I->getParent()->end(); ib != ie; ib++) {
+                  if(isa<PHINode>(&*ib)) {
+                     PHINode *pn = llvm::dyn_cast<PHINode>(&*ib);   
+                     for(unsigned ii = 0; ii < pn->getNumIncomingValues(); ii++) {
+                        Instruction *instr = dyn_cast<Instruction>(pn->getOperand(ii));
+                        if(instr != NULL) {
+                           addPointees(newInfo, Ri, newInfo, regNode(instr));
+                        }
+                     } // end for()
+                  }
+               } // end for()
+               break;
 
+            default:
+               break;
+
+         }
+
+
+         for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
+            Infos.push_back(newInfo);
+         }
+
+      } // end flowfunction
+
+      /*
+       * The node of the value of V, which must be an instruction as far as the lattice goes.
+       */
+      unsigned regNode(Value *V) {
+         return Info::regNode(this->getInstrToIndex(dyn_cast<Instruction>(V)));
+      }
+
+      /*
+       * Set node to the node of V and return true if V is an instruction.
+       */
+      bool operandNode(Value *V, unsigned &node) {
+         if(!isa<Instruction>(V))
+            return false;
+         node = regNode(V);
+         return true;
+      }
+
+      /*
+       * Make pointer point to everything source points to in from.
+       */
+      void addPointees(Info *info, unsigned pointer, Info *from, unsigned source) {
+         const typename Info::PointsToSet *pointees = from->pointsTo(source);
+         if(pointees != NULL) {
+            info->addPointsTo(pointer, *pointees);
+         }
+      }
+
+      /*
+       * The facts flowfunction derives are pointer -> pointee pairs built from one or two
+       * facts of its input, so a new output fact needs at least one of them in Delta.
+       * Loads and stores combine two facts: each is tried once from Delta, with the other
+       * looked up in In.
+       */
+      bool deltaflowfunction(Instruction * I,
+                             Info * In,
+                             Info * Delta,
+                             std::vector<unsigned> & OutgoingEdges,
+                             std::vector<Info *> & Infos) {
+
+         Info *newInfo = this->allocateInfo();
+         *newInfo = *Delta;
+
+         if(generates(I)) {
+            unsigned Ri = Info::regNode(this->getInstrToIndex(I));
+
+            switch(getInstrType(I)) {
+               case BITCAST:
+               case GETELEMENTPTR:
+                  addPointees(newInfo, Ri, Delta, regNode(I->getOperand(0)));
+                  break;
+
+               case LOAD: {
+                     unsigned Rp = regNode(I->getOperand(0));
+                     const typename Info::PointsToSet *newPointees = Delta->pointsTo(Rp);
+                     if(newPointees != NULL) {
+                        for(unsigned x : *newPointees) {
+                           addPointees(newInfo, Ri, In, x);
+                        }
+                     }
+                     const typename Info::PointsToSet *pointees = In->pointsTo(Rp);
+                     if(pointees != NULL) {
+                        for(unsigned x : *pointees) {
+                           addPointees(newInfo, Ri, Delta, x);
+                        }
                      }
                   }
-                  if(newInfo->info.find(Rf) != newInfo->info.end()) {
-                     for(auto x : newInfo->info[Rf]) {
-                        newInfo->addInfo(Ri, x);
+                  break;
+
+               case STORE: {
+                     unsigned Rv = regNode(I->getOperand(0));
+                     unsigned Rp = regNode(I->getOperand(1));
+                     const typename Info::PointsToSet *values = In->pointsTo(Rv);
+                     const typename Info::PointsToSet *pointers = In->pointsTo(Rp);
+                     const typename Info::PointsToSet *newValues = Delta->pointsTo(Rv);
+                     const typename Info::PointsToSet *newPointers = Delta->pointsTo(Rp);
+                     if(newValues != NULL && pointers != NULL) {
+                        for(unsigned y : *pointers) {
+                           newInfo->addPointsTo(y, *newValues);
+                        }
+                     }
+                     if(values != NULL && newPointers != NULL) {
+                        for(unsigned y : *newPointers) {
+                           newInfo->addPointsTo(y, *values);
+                        }
                      }
                   }
-               }
-               break;
+                  break;
+
+               case SELECT:
+                  addPointees(newInfo, Ri, Delta, regNode(I->getOperand(1)));
+                  addPointees(newInfo, Ri, Delta, regNode(I->getOperand(2)));
+                  break;
 
-            case PHI: {
-                  pointerInfo_t Ri = make_pair('R', index);
+               case PHI:
                   for(auto ib = I->getParent()->begin(), ie = I->getParent()->end(); ib != ie; ib++) {
                      if(isa<PHINode>(&*ib)) {
-                        PHINode *pn = llvm::dyn_cast<PHINode>(&*ib);   
+                        PHINode *pn = llvm::dyn_cast<PHINode>(&*ib);
                         for(unsigned ii = 0; ii < pn->getNumIncomingValues(); ii++) {
                            Instruction *instr = dyn_cast<Instruction>(pn->getOperand(ii));
-
                            if(instr != NULL) {
-                              if(newInfo->info.find(make_pair('R', this->getInstrToIndex(instr))) != newInfo->info.end()) {
-                                 for(auto x : newInfo->info[make_pair('R', this->getInstrToIndex(instr))]) {
-                                    newInfo->addInfo(Ri, x);
-                                 }
-                              }
+                              addPointees(newInfo, Ri, Delta, regNode(instr));
                            }
-                        } // end for()
+                        }
                      }
-                  } // end for()
-
-               }
-               break;
-
-            default:
-               break;
+                  }
+                  break;
 
+               default:
+                  break;
+            }
          }
 
-
          for(unsigned i = 0; i < OutgoingEdges.size(); i++) {
             Infos.push_back(newInfo);
          }
-
-      } // end flowfunction
+         return true;
+      } // end deltaflowfunction
 
    public:
-      MayPointToAnalysis(Info &bottom, Info &initState) : DataFlowAnalysis<Info, Direction>(bottom, initState) {}
+      MayPointToAnalysis(Info &bottom, Info &initState) : Base(bottom, initState) {}
+
+      /*
+       * Let runWorklistAlgorithm(func) skip the instructions that add no facts in the
+       * flow-insensitive solution. They cannot add any in the flow-sensitive one either,
+       * so the result is the same; sparse mode gets a smaller graph.
+       */
+      void seedFlowInsensitive(Function *func) {
+         unsigned numInstrs = solveFlowInsensitive(func, Andersen);
+
+         Generates.clear();
+         Generates.resize(numInstrs + 1);
+         for(inst_iterator I = inst_begin(func), E = inst_end(func); I != E; ++I) {
+            Instruction *instr = &*I;
+            if(isNotPointerOrStore(instr)) continue;
+
+            unsigned index = this->getInstrToIndex(instr);
+            bool adds = getInstrType(instr) == STORE
+                      ? !Andersen.pointsTo(regNode(instr->getOperand(0))).empty() &&
+                        !Andersen.pointsTo(regNode(instr->getOperand(1))).empty()
+                      : !Andersen.pointsTo(Info::regNode(index)).empty();
+            if(adds) {
+               Generates.set(index);
+            }
+         }
+         Seeded = true;
+      }
+
+      /*
+       * Solve func flow-insensitively with solver instead of running the worklist
+       * algorithm, and put that solution on every edge.
+       */
+      template <class Solver>
+      void runFlowInsensitive(Function *func, Solver &solver) {
+         solveFlowInsensitive(func, solver);
+
+         // The nodes of index 0, the dummy instruction, stand for nothing.
+         Info result;
+         for(unsigned n = Info::memNode(1); n < solver.numNodes(); n++) {
+            result.addPointsTo(n, solver.pointsTo(n));
+         }
+         this->assignToAllEdges(func, result);
+      }
 
 };
 
 
 namespace {
+   /*
+    * The flow-insensitive solver the command line picks for F: "andersen", "steensgaard",
+    * or "" to keep the flow-sensitive analysis.
+    */
+   StringRef solverFor(Function &F) {
+      if ((!FlowInsensitive && !Unification) ||
+          std::find(FlowSensitiveOnly.begin(), FlowSensitiveOnly.end(),
+                    F.getName().str()) != FlowSensitiveOnly.end())
+         return "";
+      return FlowInsensitive ? "andersen" : "steensgaard";
+   }
+
+   /*
+    * Solve F with analysis in the mode the command line asks for. With onDemand, the
+    * flow-sensitive analysis is only prepared for queries.
+    */
+   void solveFunction(MayPointToAnalysis<MayPointToInfo, true> &analysis, Function &F, bool onDemand) {
+      analysis.setWeakTopologicalOrder(WeakTopological);
+      analysis.setDeltaMode(Delta);
+      analysis.setInterning(Intern);
+      analysis.setSparseMode(Sparse);
+      analysis.setCollectStats(!StatsFile.empty());
+
+      StringRef solver = solverFor(F);
+      if (solver == "andersen") {
+         AndersenSolver solver;
+         analysis.runFlowInsensitive(&F, solver);
+      }
+      else if (solver == "steensgaard") {
+         SteensgaardSolver solver;
+         analysis.runFlowInsensitive(&F, solver);
+      }
+      else {
+         if (FlowInsensitiveSeed)
+            analysis.seedFlowInsensitive(&F);
+         if (onDemand)
+            analysis.prepareQueries(&F);
+         else
+            analysis.runWorklistAlgorithm(&F);
+      }
+   }
+
+   /*
+    * Run the analysis on F and print its results to OS.
+    */
+   void analyzeFunction(Function &F, raw_ostream &OS) {
+      MayPointToInfo bott;
+      MayPointToInfo init;
+
+      MayPointToAnalysis<MayPointToInfo, true> analysis(bott, init);
+      analysis.setBoundaryMode(Boundary);
+      analysis.setCollectStats(!StatsFile.empty());
+
+      // The flow-insensitive solvers give other results, so they get entries of their own.
+      ResultCache cache(CacheDir, "cse231-maypointto");
+      std::string key = cache.getKey(F, solverFor(F));
+      std::string data;
+      bool cached = cache.lookup(key, data) && analysis.readResults(&F, data);
+
+      if (!cached)
+         solveFunction(analysis, F, !QueryPoints.empty());
+      if (QueryPoints.empty()) {
+         if (!cached && cache.isEnabled())
+            cache.store(key, analysis.writeResults());
+         if (BinaryOutput)
+            analysis.printBinary(OS);
+         else
+            analysis.print(OS);
+      }
+      else if (BinaryOutput) {
+         std::vector<unsigned> points(QueryPoints.begin(), QueryPoints.end());
+         analysis.printBinary(OS, &points);
+      }
+      else {
+         for (unsigned index : QueryPoints)
+            analysis.printQuery(index, OS);
+      }
+
+      if (!StatsFile.empty())
+         appendStatsLine(StatsFile, "cse231-maypointto", analysis.getStats());
+   }
+
+   /*
+    * Open Results where the command line asks. Returns false, after reporting why on stderr,
+    * if the file cannot be created; the pass then analyzes nothing.
+    */
+   bool openResults(ResultStream &Results) {
+      if (std::error_code error = Results.open(OutputFile, BinaryOutput, "cse231-maypointto")) {
+         errs() << "error: cannot write cse231-maypointto results to " << OutputFile << ": " << error.message() << "\n";
+         return false;
+      }
+      return true;
+   }
+
    struct MayPointToAnalysisPass : public FunctionPass {
       public:
          static char ID;
          MayPointToAnalysisPass() : FunctionPass(ID) {}
-         bool runOnFunction(Function &F) override { 
-            MayPointToInfo *bott = new MayPointToInfo();
-            MayPointToInfo *init = new MayPointToInfo();
 
-            MayPointToAnalysis<MayPointToInfo, true> analysis(*bott, *init);
+         bool doInitialization(Module &M) override {
+            openResults(Results);
+            return false;
+         }
 
-            analysis.runWorklistAlgorithm(&F);
-            analysis.print();
+         bool runOnFunction(Function &F) override { 
+            if (!Results.isOpen())
+               return false;
+            analyzeFunction(F, Results.stream());
+            Results.flush();
             return false;
          }
+
+         bool doFinalization(Module &M) override {
+            Results.close();
+            ResultCache(CacheDir, "cse231-maypointto").prune((uint64_t)CacheSize << 20);
+            return false;
+         }
+
+      private:
+         ResultStream Results;
    }; 
+
+   /*
+    * Analyzes all functions of the module concurrently, printing them in module order.
+    */
+   struct MayPointToModulePass : public ModulePass {
+      public:
+         static char ID;
+         MayPointToModulePass() : ModulePass(ID) {}
+         bool runOnModule(Module &M) override {
+            ResultStream results;
+            if (!openResults(results))
+               return false;
+            runOnFunctionsInParallel(M, Threads, results.stream(), analyzeFunction);
+            results.close();
+            ResultCache(CacheDir, "cse231-maypointto").prune((uint64_t)CacheSize << 20);
+            return false;
+         }
+   };
+
+   /*
+    * No-alias answers for the pointers of one function, from its cse231-maypointto
+    * results. The analysis models only what flowfunction handles, so a points-to set is
+    * trusted only for a complete pointer, one whose set covers every alloca it can point
+    * to: an alloca; a cast, GEP, select or phi of complete pointers; or a load through a
+    * complete pointer from private slots. A private slot is an alloca whose address is
+    * only loaded from, compared, and stored to with complete pointers, in stores the
+    * analysis saw. Two complete pointers with disjoint sets are based on different
+    * allocas and do not alias.
+    *
+    * In SSA form a pointer's set is the same wherever the pointer is defined, so one set
+    * per pointer, taken right after its definition, answers queries at every point.
+    */
+   class MayPointToOracle {
+
+      typedef MayPointToInfo::PointsToSet PointsToSet;
+
+      // An entry goes away with its value, so a value created after the analysis, say by
+      // the transformation asking, never inherits the set of a deleted one.
+      struct SlotConfig : ValueMapConfig<const Value *> {
+         enum { FollowRAUW = false };
+      };
+
+      ValueMap<const Value *, unsigned, SlotConfig> Slots;
+      std::vector<PointsToSet> Pointees;
+
+      // Whether the sets of two slots, lower one first, are disjoint.
+      DenseMap<std::pair<unsigned, unsigned>, bool> Disjoint;
+
+      typedef MayPointToAnalysis<MayPointToInfo, true> Analysis;
+
+      /*
+       * The set of V right after its definition, or NULL if it has none.
+       */
+      static const PointsToSet * pointeesOf(Analysis &analysis, Value *V) {
+         Instruction *I = dyn_cast<Instruction>(V);
+         MayPointToInfo *after = I ? analysis.getInfoAfter(I) : nullptr;
+         if (after == nullptr)
+            return nullptr;
+         return after->pointsTo(MayPointToInfo::regNode(analysis.getInstrToIndex(I)));
+      }
+
+      static bool isComplete(const SmallPtrSetImpl<Value *> &complete, Value *V) {
+         return isa<ConstantPointerNull>(V) || isa<UndefValue>(V) || complete.count(V);
+      }
+
+      /*
+       * Collect the values stored into the memory of alloca, or return false if its address
+       * escapes or is written in a way the analysis missed.
+       */
+      static bool findStoredValues(Analysis &analysis, Instruction *alloca,
+                                   SmallVectorImpl<Value *> &stored) {
+         unsigned node = MayPointToInfo::memNode(analysis.getInstrToIndex(alloca));
+         SmallVector<Value *, 8> derived(1, alloca);
+         SmallPtrSet<Value *, 8> seen;
+         seen.insert(alloca);
+
+         while (!derived.empty()) {
+            Value *address = derived.pop_back_val();
+            for (User *user : address->users()) {
+               if (isa<LoadInst>(user) || isa<ICmpInst>(user))
+                  continue;
+
+               if (StoreInst *store = dyn_cast<StoreInst>(user)) {
+                  const PointsToSet *pointees = pointeesOf(analysis, address);
+                  if (store->getValueOperand() == address || pointees == nullptr || !pointees->test(node))
+                     return false;
+                  stored.push_back(store->getValueOperand());
+                  continue;
+               }
+
+               if (isa<BitCastInst>(user) || isa<GetElementPtrInst>(user) ||
+                   isa<SelectInst>(user) || isa<PHINode>(user)) {
+                  if (seen.insert(user).second)
+                     derived.push_back(user);
+                  continue;
+               }
+               return false;
+            }
+         }
+         return true;
+      }
+
+   public:
+      explicit MayPointToOracle(Function &F) {
+         MayPointToInfo bott;
+         MayPointToInfo init;
+         Analysis analysis(bott, init);
+         solveFunction(analysis, F, false);
+
+         // Assume every pointer the rules cover is complete and drop those that are not
+         // until none is left to drop.
+         SmallPtrSet<Value *, 32> complete;
+         std::vector<Instruction *> candidates;
+         for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+            Instruction *instr = &*I;
+            if (!instr->getType()->isPointerTy())
+               continue;
+            if (isa<AllocaInst>(instr) || isa<BitCastInst>(instr) || isa<GetElementPtrInst>(instr) ||
+                isa<SelectInst>(instr) || isa<LoadInst>(instr) ||
+                (isa<PHINode>(instr) && instr == &instr->getParent()->front())) {
+               complete.insert(instr);
+               candidates.push_back(instr);
+            }
+         }
+
+         DenseMap<Instruction *, SmallVector<Value *, 4> > storedValues;
+         SmallPtrSet<Instruction *, 16> escaping;
+         for (Instruction *instr : candidates) {
+            if (isa<AllocaInst>(instr) && !findStoredValues(analysis, instr, storedValues[instr]))
+               escaping.insert(instr);
+         }
+
+         auto isPrivate = [&](unsigned node) {
+            Instruction *alloca = analysis.getIndexToInstr(node / 2);
+            if (node % 2 != 0 || alloca == nullptr || !isa<AllocaInst>(alloca) || escaping.count(alloca))
+               return false;
+            for (Value *V : storedValues[alloca]) {
+               if (!isComplete(complete, V))
+                  return false;
+            }
+            return true;
+         };
+
+         auto stillComplete = [&](Instruction *instr) {
+            if (isa<AllocaInst>(instr))
+               return true;
+            if (isa<BitCastInst>(instr) || isa<GetElementPtrInst>(instr))
+               return isComplete(complete, instr->getOperand(0));
+            if (isa<SelectInst>(instr))
+               return isComplete(complete, instr->getOperand(1)) && isComplete(complete, instr->getOperand(2));
+            if (PHINode *phi = dyn_cast<PHINode>(instr)) {
+               for (Value *incoming : phi->incoming_values()) {
+                  if (!isComplete(complete, incoming))
+                     return false;
+               }
+               return true;
+            }
+
+            // A load.
+            Value *address = instr->getOperand(0);
+            if (!isComplete(complete, address))
+               return false;
+            if (const PointsToSet *slots = pointeesOf(analysis, address)) {
+               for (unsigned slot : *slots) {
+                  if (!isPrivate(slot))
+                     return false;
+               }
+            }
+            return true;
+         };
+
+         bool changed = true;
+         while (changed) {
+            changed = false;
+            for (Instruction *instr : candidates) {
+               if (complete.count(instr) && !stillComplete(instr)) {
+                  complete.erase(instr);
+                  changed = true;
+               }
+            }
+         }
+
+         for (Instruction *instr : candidates) {
+            const PointsToSet *pointees = pointeesOf(analysis, instr);
+            if (complete.count(instr) && pointees != nullptr && !pointees->empty()) {
+               Slots[instr] = Pointees.size();
+               Pointees.push_back(*pointees);
+            }
+         }
+      }
+
+      /*
+       * Whether A and B, pointers of this function, are known not to alias.
+       */
+      bool noAlias(const Value *A, const Value *B) {
+         auto slotA = Slots.find(A);
+         auto slotB = Slots.find(B);
+         if (slotA == Slots.end() || slotB == Slots.end() || slotA->second == slotB->second)
+            return false;
+
+         std::pair<unsigned, unsigned> key(std::min(slotA->second, slotB->second),
+                                           std::max(slotA->second, slotB->second));
+         auto iter = Disjoint.find(key);
+         if (iter != Disjoint.end())
+            return iter->second;
+
+         bool disjoint = !Pointees[key.first].intersects(Pointees[key.second]);
+         Disjoint[key] = disjoint;
+         return disjoint;
+      }
+   };
+
+   /*
+    * cse231-maypointto as an alias analysis. Each function gets an oracle on its first
+    * query; the oracles are dropped whenever the pass manager builds a new alias
+    * analysis stack, since the IR may have changed in between.
+    */
+   class MayPointToAAResult : public AAResultBase<MayPointToAAResult> {
+
+      std::map<const Function *, std::unique_ptr<MayPointToOracle> > Oracles;
+
+      static const Function * functionOf(const Value *V) {
+         const Instruction *I = dyn_cast<Instruction>(V);
+         return I ? I->getFunction() : nullptr;
+      }
+
+   public:
+      void reset() {
+         Oracles.clear();
+      }
+
+#if LLVM_VERSION_MAJOR >= 9
+      AliasResult alias(const MemoryLocation &LocA, const MemoryLocation &LocB, AAQueryInfo &AAQI) {
+#else
+      AliasResult alias(const MemoryLocation &LocA, const MemoryLocation &LocB) {
+#endif
+         const Function *F = functionOf(LocA.Ptr);
+         if (F != nullptr && F == functionOf(LocB.Ptr)) {
+            std::unique_ptr<MayPointToOracle> &oracle = Oracles[F];
+            if (!oracle)
+               oracle.reset(new MayPointToOracle(*const_cast<Function *>(F)));
+            if (oracle->noAlias(LocA.Ptr, LocB.Ptr))
+               return AliasResult::NoAlias;
+         }
+#if LLVM_VERSION_MAJOR >= 9
+         return AAResultBase::alias(LocA, LocB, AAQI);
+#else
+         return AAResultBase::alias(LocA, LocB);
+#endif
+      }
+   };
+
+   /*
+    * Adds MayPointToAAResult to the alias analyses of the legacy pass manager, for passes
+    * like GVN, LICM and DSE: opt -cse231-maypointto-aa -gvn ...
+    */
+   struct MayPointToAAWrapperPass : public ExternalAAWrapperPass {
+      public:
+         static char ID;
+         MayPointToAAResult Result;
+         MayPointToAAWrapperPass() : ExternalAAWrapperPass([this](Pass &, Function &, AAResults &AAR) {
+               Result.reset();
+               AAR.addAAResult(Result);
+            }) {}
+   };
 }
 
 char MayPointToAnalysisPass::ID = 0;
 static RegisterPass<MayPointToAnalysisPass> X("cse231-maypointto",
                                             "Developed to test LLVM and docker",
                                             false /* Only looks at CFG */,
-                                            false /* Analysis Pass */);
\ No newline at end of file
+                                            false /* Analysis Pass */);
+
+char MayPointToModulePass::ID = 0;
+static RegisterPass<MayPointToModulePass> Y("cse231-maypointto-module",
+                                            "Runs cse231-maypointto on all functions in parallel",
+                                            false /* Only looks at CFG */,
+                                            false /* Analysis Pass */);
+
+char MayPointToAAWrapperPass::ID = 0;
+static RegisterPass<MayPointToAAWrapperPass> Z("cse231-maypointto-aa",
+                                            "Answers alias queries from cse231-maypointto",
+                                            false /* Only looks at CFG */,
+                                            true /* Analysis Pass */);
@@ -0,0 +1,647 @@
+//===- MayPointToInfo.h - Lattice of the may-point-to analysis ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the Info used by cse231-maypointto. It is kept apart from the
+// pass so it can be used without an LLVM module, e.g. by bench/LatticeBench.cpp.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_MAYPOINTTOINFO_H
+#define LLVM_TRANSFORMS_MAYPOINTTOINFO_H
+
+#include "231DFA.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <utility>
+
+namespace llvm {
+
+/*
+ * A pointer or memory object: ('R', i) is the value of instruction i and
+ * ('M', i) the memory allocated by instruction i.
+ */
+typedef std::pair<char, unsigned> pointerInfo_t;
+
+
+/*
+ * A set of node ids in one of two layouts: a sorted array of the ids while the set is
+ * sparse, and a bitmap of 32-bit words over the range the ids span once that takes less
+ * room. The layout depends only on the ids in the set, so equal sets have equal layouts
+ * and compare word by word. Sets of up to InlineIds ids need no heap memory.
+ */
+class PointsToSet {
+
+   static const unsigned WordBits = 32;
+   static const unsigned InlineIds = 4;
+
+   // The sorted ids, or the words of the bitmap, the first covering ids from
+   // Base * WordBits. The first and the last word are never zero.
+   SmallVector<unsigned, InlineIds> Data;
+   unsigned Base = 0;
+   unsigned Count = 0;
+   bool Dense = false;
+
+   static bool wantDense(unsigned count, unsigned firstWord, unsigned lastWord) {
+      return count > InlineIds && lastWord - firstWord + 1 < count;
+   }
+
+   void toDense() {
+      SmallVector<unsigned, InlineIds> words;
+      unsigned base = Data.front() / WordBits;
+      words.resize(Data.back() / WordBits - base + 1);
+      for(unsigned id : Data) {
+         words[id / WordBits - base] |= 1u << (id % WordBits);
+      }
+      Data.swap(words);
+      Base = base;
+      Dense = true;
+   }
+
+   void toSparse() {
+      SmallVector<unsigned, InlineIds> ids;
+      ids.reserve(Count);
+      for(unsigned id : *this) {
+         ids.push_back(id);
+      }
+      Data.swap(ids);
+      Base = 0;
+      Dense = false;
+   }
+
+   /*
+    * Switch to the layout the ids call for.
+    */
+   void normalize() {
+      if(Count == 0) {
+         Data.clear();
+         Base = 0;
+         Dense = false;
+         return;
+      }
+      bool dense = Dense ? wantDense(Count, Base, Base + Data.size() - 1)
+                         : wantDense(Count, Data.front() / WordBits, Data.back() / WordBits);
+      if(dense != Dense) {
+         if(dense) toDense();
+         else toSparse();
+      }
+   }
+
+   /*
+    * Both sets dense: or the words over the range they span together.
+    */
+   template <class Fn>
+   unsigned unionDense(const PointsToSet &other, Fn onAdded) {
+      unsigned base = std::min(Base, other.Base);
+      unsigned end = std::max(Base + (unsigned)Data.size(), other.Base + (unsigned)other.Data.size());
+      SmallVector<unsigned, InlineIds> words(end - base, 0u);
+      unsigned added = 0;
+      for(unsigned i = 0; i < Data.size(); i++) {
+         words[Base - base + i] = Data[i];
+      }
+      for(unsigned i = 0; i < other.Data.size(); i++) {
+         unsigned &word = words[other.Base - base + i];
+         unsigned fresh = other.Data[i] & ~word;
+         if(fresh == 0) continue;
+
+         added += countPopulation(fresh);
+         word |= fresh;
+         for(unsigned bits = fresh; bits != 0; bits &= bits - 1) {
+            onAdded((other.Base + i) * WordBits + countTrailingZeros(bits));
+         }
+      }
+      if(added == 0) return 0;
+
+      Data.swap(words);
+      Base = base;
+      Count += added;
+      normalize();
+      return added;
+   }
+
+   /*
+    * Merge the sorted ids [a, ae) and [b, be) into merged and return how many came from b
+    * alone, calling onAdded for each.
+    */
+   template <class IterA, class IterB, class Fn>
+   static unsigned mergeIds(IterA a, IterA ae, IterB b, IterB be,
+                            SmallVectorImpl<unsigned> &merged, Fn onAdded) {
+      unsigned added = 0;
+      while(a != ae && b != be) {
+         if(*a < *b) {
+            merged.push_back(*a);
+            ++a;
+         }
+         else if(*b < *a) {
+            onAdded(*b);
+            added++;
+            merged.push_back(*b);
+            ++b;
+         }
+         else {
+            merged.push_back(*a);
+            ++a;
+            ++b;
+         }
+      }
+      for(; a != ae; ++a) {
+         merged.push_back(*a);
+      }
+      for(; b != be; ++b) {
+         onAdded(*b);
+         added++;
+         merged.push_back(*b);
+      }
+      return added;
+   }
+
+public:
+
+   class iterator {
+      const PointsToSet *Set;
+      unsigned Pos;
+      unsigned Bits;
+
+   public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef unsigned value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const unsigned *pointer;
+      typedef unsigned reference;
+
+      iterator(const PointsToSet *set, bool end) : Set(set), Pos(0), Bits(0) {
+         if(end) Pos = set->Data.size();
+         else if(set->Dense) Bits = set->Data[0];
+      }
+
+      unsigned operator*() const {
+         if(!Set->Dense) return Set->Data[Pos];
+         return (Set->Base + Pos) * WordBits + countTrailingZeros(Bits);
+      }
+
+      iterator &operator++() {
+         if(!Set->Dense) {
+            Pos++;
+            return *this;
+         }
+         Bits &= Bits - 1;
+         while(Bits == 0 && ++Pos < Set->Data.size()) {
+            Bits = Set->Data[Pos];
+         }
+         return *this;
+      }
+
+      bool operator==(const iterator &other) const {
+         return Pos == other.Pos && Bits == other.Bits;
+      }
+
+      bool operator!=(const iterator &other) const {
+         return !(*this == other);
+      }
+   };
+
+   iterator begin() const {
+      return iterator(this, false);
+   }
+
+   iterator end() const {
+      return iterator(this, true);
+   }
+
+   bool empty() const {
+      return Count == 0;
+   }
+
+   unsigned count() const {
+      return Count;
+   }
+
+   bool test(unsigned id) const {
+      if(!Dense) return std::binary_search(Data.begin(), Data.end(), id);
+
+      unsigned word = id / WordBits;
+      if(word < Base || word - Base >= Data.size()) return false;
+      return (Data[word - Base] >> (id % WordBits)) & 1;
+   }
+
+   /*
+    * Add id and return whether it was new.
+    */
+   bool test_and_set(unsigned id) {
+      unsigned word = id / WordBits;
+      if(Dense) {
+         unsigned first = std::min(word, Base);
+         unsigned last = std::max(word, Base + (unsigned)Data.size() - 1);
+         if(!wantDense(Count + 1, first, last)) {
+            if(test(id)) return false;
+            toSparse();
+         }
+      }
+
+      if(!Dense) {
+         auto iter = std::lower_bound(Data.begin(), Data.end(), id);
+         if(iter != Data.end() && *iter == id) return false;
+         Data.insert(iter, id);
+         Count++;
+         normalize();
+         return true;
+      }
+
+      if(word < Base) {
+         Data.insert(Data.begin(), Base - word, 0u);
+         Base = word;
+      }
+      else if(word - Base >= Data.size()) {
+         Data.resize(word - Base + 1, 0u);
+      }
+      unsigned &bits = Data[word - Base];
+      unsigned bit = 1u << (id % WordBits);
+      if(bits & bit) return false;
+      bits |= bit;
+      Count++;
+      return true;
+   }
+
+   /*
+    * Add the ids of other, calling onAdded(id) for each id that is new, and return how
+    * many there were.
+    */
+   template <class Fn>
+   unsigned unionWith(const PointsToSet &other, Fn onAdded) {
+      if(&other == this || other.empty()) return 0;
+
+      if(Dense && other.Dense) return unionDense(other, onAdded);
+
+      // Nothing new is the common case at the fixpoint; find it out without allocating.
+      bool sparse = !Dense && !other.Dense;
+      if(sparse ? std::includes(Data.begin(), Data.end(), other.Data.begin(), other.Data.end())
+                : std::includes(begin(), end(), other.begin(), other.end())) {
+         return 0;
+      }
+
+      SmallVector<unsigned, InlineIds> merged;
+      merged.reserve(Count + other.Count);
+      unsigned added = sparse
+                     ? mergeIds(Data.begin(), Data.end(), other.Data.begin(), other.Data.end(), merged, onAdded)
+                     : mergeIds(begin(), end(), other.begin(), other.end(), merged, onAdded);
+
+      Data.swap(merged);
+      Base = 0;
+      Dense = false;
+      Count += added;
+      normalize();
+      return added;
+   }
+
+   /*
+    * The ids of a that are not in b.
+    */
+   static PointsToSet difference(const PointsToSet &a, const PointsToSet &b) {
+      PointsToSet result;
+      // Neighbouring program points mostly hold the same sets.
+      if(a == b) return result;
+      for(unsigned id : a) {
+         if(!b.test(id)) result.Data.push_back(id);
+      }
+      result.Count = result.Data.size();
+      result.normalize();
+      return result;
+   }
+
+   /*
+    * Whether the sets share an id.
+    */
+   bool intersects(const PointsToSet &other) const {
+      if(Dense && other.Dense) {
+         unsigned first = std::max(Base, other.Base);
+         unsigned end = std::min(Base + (unsigned)Data.size(), other.Base + (unsigned)other.Data.size());
+         for(unsigned word = first; word < end; word++) {
+            if(Data[word - Base] & other.Data[word - other.Base]) return true;
+         }
+         return false;
+      }
+
+      // Look the smaller set up in the larger one.
+      const PointsToSet &small = Count <= other.Count ? *this : other;
+      const PointsToSet &large = Count <= other.Count ? other : *this;
+      for(unsigned id : small) {
+         if(large.test(id)) return true;
+      }
+      return false;
+   }
+
+   bool operator==(const PointsToSet &other) const {
+      return Count == other.Count && Dense == other.Dense && Base == other.Base && Data == other.Data;
+   }
+
+   bool operator!=(const PointsToSet &other) const {
+      return !(*this == other);
+   }
+};
+
+
+/*
+ * Points-to facts over dense node ids: memory object i is node 2i and the value of
+ * instruction i is node 2i+1. The pointees of each pointer are a PointsToSet.
+ */
+class MayPointToInfo : public Info {
+
+public:
+   typedef llvm::PointsToSet PointsToSet;
+
+private:
+   /*
+    * Summary of the pairs, kept up to date by every member that changes info: the number of
+    * (pointer, pointee) pairs, the sum of their hashes, and an epoch. Epochs come from a
+    * global counter and are handed out on every change, so two values with the same epoch
+    * hold the same pairs (one is an unchanged copy of the other). The empty value has epoch 0.
+    */
+   size_t Pairs = 0;
+   uint64_t Fingerprint = 0;
+   uint64_t Epoch = 0;
+
+   static uint64_t newEpoch() {
+      static std::atomic<uint64_t> Clock(0);
+      return ++Clock;
+   }
+
+   static uint64_t hashPair(unsigned pointer, unsigned pointee) {
+      return hash_value(((uint64_t)pointer << 32) | pointee);
+   }
+
+   static uint64_t hashPointees(unsigned pointer, const PointsToSet &pointees) {
+      uint64_t sum = 0;
+      for(unsigned pointee : pointees) {
+         sum += hashPair(pointer, pointee);
+      }
+      return sum;
+   }
+
+   /*
+    * Adds pointees to the set of pointer and returns the number of pairs added, which are
+    * counted in Pairs and Fingerprint. The caller moves Epoch.
+    */
+   size_t unionPointees(unsigned pointer, const PointsToSet &pointees) {
+      if(pointees.empty()) return 0;
+
+      PointsToSet &set = info[pointer];
+      if(set.empty()) {
+         set = pointees;
+         Pairs += pointees.count();
+         Fingerprint += hashPointees(pointer, pointees);
+         return pointees.count();
+      }
+
+      uint64_t fingerprint = 0;
+      size_t added = set.unionWith(pointees, [&](unsigned pointee) {
+         fingerprint += hashPair(pointer, pointee);
+      });
+      Pairs += added;
+      Fingerprint += fingerprint;
+      return added;
+   }
+
+   static void printNode(raw_ostream &OS, unsigned node) {
+      OS << (node & 1 ? 'R' : 'M') << (node >> 1);
+   }
+
+
+public:
+
+   /*
+    * Pointers and their pointees. Read it freely, but change it only through
+    * addInfo, addPointsTo, join and subtract, which keep the summary above in step.
+    */
+   std::map<unsigned, PointsToSet> info;
+
+   static unsigned memNode(unsigned index) {
+      return 2 * index;
+   }
+
+   static unsigned regNode(unsigned index) {
+      return 2 * index + 1;
+   }
+
+   static unsigned nodeId(pointerInfo_t pointer) {
+      return pointer.first == 'M' ? memNode(pointer.second) : regNode(pointer.second);
+   }
+
+   void print() {
+      print(errs());
+   }
+
+   /*
+    * Nodes are listed in pointerInfo_t order, memory objects before values.
+    */
+   void print(raw_ostream &OS) {
+      for(unsigned kind = 0; kind < 2; kind++) {
+         for(auto &pointer : info) {
+            if((pointer.first & 1) != kind) continue;
+
+            printNode(OS, pointer.first);
+            OS << "->(";
+            for(unsigned pointeeKind = 0; pointeeKind < 2; pointeeKind++) {
+               for(unsigned pointee : pointer.second) {
+                  if((pointee & 1) != pointeeKind) continue;
+                  printNode(OS, pointee);
+                  OS << "/";
+               }
+            }
+            OS << ")|";
+         }
+      }
+      OS << "\n";
+   }
+
+   /*
+    * The pointees of pointer, or NULL if it points to nothing.
+    */
+   const PointsToSet * pointsTo(unsigned pointer) const {
+      auto iter = info.find(pointer);
+      return iter == info.end() ? NULL : &iter->second;
+   }
+
+   void addInfo(unsigned pointer, unsigned pointee) {
+      PointsToSet &set = info[pointer];
+      if(!set.test_and_set(pointee)) return;
+
+      Pairs++;
+      Fingerprint += hashPair(pointer, pointee);
+      Epoch = newEpoch();
+   }
+
+   void addInfo(pointerInfo_t pointer, pointerInfo_t pointee) {
+      addInfo(nodeId(pointer), nodeId(pointee));
+   }
+
+   /*
+    * Make pointer also point to all of pointees, which may be a set of this value.
+    */
+   void addPointsTo(unsigned pointer, const PointsToSet &pointees) {
+      if(unionPointees(pointer, pointees) != 0) {
+         Epoch = newEpoch();
+      }
+   }
+
+   /*
+    * Values of the same epoch are equal and values of different size or fingerprint are
+    * not; only the rest are compared pair by pair. Equal values found that way take the
+    * same epoch, so comparing them again is immediate.
+    */
+   static bool equals(MayPointToInfo *info1, MayPointToInfo *info2) {
+      if(info1 == info2 || info1->Epoch == info2->Epoch) return true;
+      if(info1->Pairs != info2->Pairs || info1->Fingerprint != info2->Fingerprint) return false;
+
+      if(info1->info != info2->info) return false;
+      info2->Epoch = info1->Epoch;
+      return true;
+   }
+
+
+   /*
+    * Adds the pointers of info1 that result lacks, then merges in all of info2.
+    * Joining into info1 itself only touches the pointers of info2.
+    */
+   static MayPointToInfo* join(MayPointToInfo *info1, MayPointToInfo *info2, MayPointToInfo *result) {
+      if(result == NULL || info1 == NULL || info2 == NULL) return result;
+
+      size_t added = 0;
+      if(result != info1) {
+         if(result->Pairs == 0) {
+            *result = *info1;
+         }
+         else {
+            for(auto &val : info1->info) {
+               if(result->info.insert(val).second) {
+                  result->Fingerprint += hashPointees(val.first, val.second);
+                  added += val.second.count();
+               }
+            }
+            result->Pairs += added;
+         }
+      }
+
+      // Joining into an empty value copies info2, epoch included.
+      bool copy = result->Pairs == 0;
+      for(auto &val : info2->info) {
+         added += result->unionPointees(val.first, val.second);
+      }
+
+      if(added != 0) {
+         result->Epoch = copy ? info2->Epoch : newEpoch();
+      }
+      return result;
+   }
+
+   /*
+    * result = info1 - info2. result may alias info1.
+    * Pointers left without pointees are dropped, so equal sets keep equal maps.
+    */
+   static MayPointToInfo* subtract(MayPointToInfo *info1, MayPointToInfo *info2, MayPointToInfo *result) {
+      if(result == NULL || info1 == NULL || info2 == NULL) return result;
+
+      // Both maps are sorted, so walk them side by side.
+      std::map<unsigned, PointsToSet> diff;
+      size_t pairs = 0;
+      uint64_t fingerprint = 0;
+      auto other = info2->info.begin();
+      for(auto &val : info1->info) {
+         while(other != info2->info.end() && other->first < val.first) ++other;
+         if(other == info2->info.end() || other->first != val.first) {
+            diff.insert(diff.end(), val);
+            pairs += val.second.count();
+            fingerprint += hashPointees(val.first, val.second);
+            continue;
+         }
+
+         PointsToSet rest = PointsToSet::difference(val.second, other->second);
+         if(!rest.empty()) {
+            pairs += rest.count();
+            fingerprint += hashPointees(val.first, rest);
+            diff.emplace_hint(diff.end(), val.first, std::move(rest));
+         }
+      }
+
+      uint64_t epoch = pairs == 0 ? 0 : pairs == info1->Pairs ? info1->Epoch : newEpoch();
+      result->info.swap(diff);
+      result->Pairs = pairs;
+      result->Fingerprint = fingerprint;
+      result->Epoch = epoch;
+      return result;
+   }
+
+   bool isEmpty() const {
+      return info.empty();
+   }
+
+   static unsigned hash(MayPointToInfo *info) {
+      return hash_combine(info->Pairs, info->Fingerprint);
+   }
+
+   /*
+    * Append info to Out for ResultCache: the number of pointers, then for each of them the
+    * gap from the previous one and its pointees the way BitVectorInfo writes a set.
+    */
+   static void serialize(MayPointToInfo *info, raw_ostream &Out) {
+      encodeULEB128(info->info.size(), Out);
+      unsigned lastPointer = 0;
+      for(auto &pointer : info->info) {
+         encodeULEB128(pointer.first - lastPointer, Out);
+         lastPointer = pointer.first;
+
+         encodeULEB128(pointer.second.count(), Out);
+         unsigned lastPointee = 0;
+         for(unsigned pointee : pointer.second) {
+            encodeULEB128(pointee - lastPointee, Out);
+            lastPointee = pointee;
+         }
+      }
+   }
+
+   /*
+    * Read a value written by serialize() at Ptr into result, which must be empty, and move
+    * Ptr past it. Returns false if the data is cut short or holds a node not below Limit.
+    */
+   static bool deserialize(const uint8_t *&Ptr, const uint8_t *End, unsigned Limit,
+                           MayPointToInfo *result) {
+      uint64_t numPointers, pointer = 0;
+      if(!readULEB128(Ptr, End, numPointers) || numPointers > Limit) return false;
+
+      for(uint64_t p = 0; p < numPointers; p++) {
+         uint64_t gap, count, pointee = 0;
+         if(!readULEB128(Ptr, End, gap) || gap >= Limit - pointer) return false;
+         pointer += gap;
+         if(!readULEB128(Ptr, End, count) || count > Limit) return false;
+
+         PointsToSet pointees;
+         for(uint64_t k = 0; k < count; k++) {
+            if(!readULEB128(Ptr, End, gap) || gap >= Limit - pointee) return false;
+            pointee += gap;
+            pointees.test_and_set(pointee);
+         }
+         result->addPointsTo(pointer, pointees);
+      }
+      return true;
+   }
+
+
+};
+
+}
+
+#endif // End LLVM_TRANSFORMS_MAYPOINTTOINFO_H
@@ -0,0 +1,183 @@
+//===- SteensgaardSolver.h - Unification-based points-to constraint solver -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file provides the solver behind cse231-maypointto's Steensgaard mode. It takes the
+// same constraints as AndersenSolver over the same node ids, but treats every assignment
+// as an equality: nodes fall into classes, each class points to at most one class, and
+// a constraint is handled once, by merging classes. That takes almost linear time in the
+// number of constraints, at the price of sets that can be larger than Andersen's.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_TRANSFORMS_STEENSGAARDSOLVER_H
+#define LLVM_TRANSFORMS_STEENSGAARDSOLVER_H
+
+#include "MayPointToInfo.h"
+
+#include "llvm/ADT/DenseMap.h"
+
+#include <utility>
+#include <vector>
+
+namespace llvm {
+
+class SteensgaardSolver {
+
+   enum : unsigned { None = ~0U };
+
+   // Nodes from NumNodes on stand for memory no node names, created when a class
+   // needs something to point to.
+   unsigned NumNodes = 0;
+   std::vector<unsigned> Parent;
+   std::vector<unsigned> Size;
+   std::vector<unsigned> Pointee;
+
+   // The named nodes of each class that something points to, after solve().
+   DenseMap<unsigned, PointsToSet> Members;
+   PointsToSet Empty;
+
+   unsigned find(unsigned n) {
+      while (Parent[n] != n) {
+         Parent[n] = Parent[Parent[n]];
+         n = Parent[n];
+      }
+      return n;
+   }
+
+   unsigned findConst(unsigned n) const {
+      while (Parent[n] != n)
+         n = Parent[n];
+      return n;
+   }
+
+   /*
+    * The class the class of n points to, made up if there is none yet.
+    */
+   unsigned pointee(unsigned n) {
+      n = find(n);
+      if (Pointee[n] == None) {
+         unsigned fresh = Parent.size();
+         Parent.push_back(fresh);
+         Size.push_back(1);
+         Pointee.push_back(None);
+         Pointee[n] = fresh;
+      }
+      return find(Pointee[n]);
+   }
+
+   /*
+    * Merge the classes of a and b, and then the classes they point to, and so on.
+    */
+   void join(unsigned a, unsigned b) {
+      std::vector<std::pair<unsigned, unsigned> > pending(1, std::make_pair(a, b));
+      while (!pending.empty()) {
+         a = find(pending.back().first);
+         b = find(pending.back().second);
+         pending.pop_back();
+         if (a == b)
+            continue;
+
+         if (Size[a] < Size[b])
+            std::swap(a, b);
+         Parent[b] = a;
+         Size[a] += Size[b];
+
+         if (Pointee[a] == None)
+            Pointee[a] = Pointee[b];
+         else if (Pointee[b] != None)
+            pending.push_back(std::make_pair(Pointee[a], Pointee[b]));
+      }
+   }
+
+public:
+
+   explicit SteensgaardSolver(unsigned numNodes = 0) {
+      reset(numNodes);
+   }
+
+   /*
+    * Drop all constraints and make room for nodes 0 .. numNodes-1.
+    */
+   void reset(unsigned numNodes) {
+      NumNodes = numNodes;
+      Parent.resize(numNodes);
+      for (unsigned n = 0; n < numNodes; n++)
+         Parent[n] = n;
+      Size.assign(numNodes, 1);
+      Pointee.assign(numNodes, None);
+      Members.clear();
+   }
+
+   unsigned numNodes() const {
+      return NumNodes;
+   }
+
+   /*
+    * pointer = &object
+    */
+   void addAddressOf(unsigned pointer, unsigned object) {
+      join(pointee(pointer), object);
+   }
+
+   /*
+    * dst = src
+    */
+   void addCopy(unsigned dst, unsigned src) {
+      join(pointee(dst), pointee(src));
+   }
+
+   /*
+    * dst = *src
+    */
+   void addLoad(unsigned dst, unsigned src) {
+      join(pointee(dst), pointee(pointee(src)));
+   }
+
+   /*
+    * *dst = src
+    */
+   void addStore(unsigned dst, unsigned src) {
+      join(pointee(pointee(dst)), pointee(src));
+   }
+
+   /*
+    * The constraints are solved as they are added; collect the members of each class.
+    */
+   void solve() {
+      // Only classes something points to are ever looked up.
+      std::vector<bool> target(Parent.size(), false);
+      for (unsigned n = 0; n < Parent.size(); n++) {
+         if (Parent[n] == n && Pointee[n] != None)
+            target[find(Pointee[n])] = true;
+      }
+
+      Members.clear();
+      for (unsigned n = 0; n < NumNodes; n++) {
+         unsigned rep = find(n);
+         if (target[rep])
+            Members[rep].test_and_set(n);
+      }
+   }
+
+   /*
+    * The points-to set of node n, after solve().
+    */
+   const PointsToSet & pointsTo(unsigned n) const {
+      unsigned target = Pointee[findConst(n)];
+      if (target == None)
+         return Empty;
+
+      auto iter = Members.find(findConst(target));
+      return iter == Members.end() ? Empty : iter->second;
+   }
+};
+
+}
+
+#endif // End LLVM_TRANSFORMS_STEENSGAARDSOLVER_H
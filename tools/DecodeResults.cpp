@@ -0,0 +1,127 @@
+//===- DecodeResults.cpp - Turn binary analysis results back into text -----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reads the results a pass wrote with -<pass>-binary (see ResultStream in 231DFA.h) and
+// prints them in the text format of print(), byte for byte what the pass would have
+// written without -<pass>-binary. Build it against LLVMSupport only:
+//
+//   g++ -O2 -std=c++14 $(llvm-config --cxxflags) -Ipart3 tools/DecodeResults.cpp
+//       $(llvm-config --ldflags --libs support) -o decode-results
+//
+// and run ./decode-results [-function=<name>] [file], which reads stdin without a file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "231DFA.h"
+#include "MayPointToInfo.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+
+static cl::opt<std::string> InputFile(cl::Positional,
+                                      cl::desc("<results file>"),
+                                      cl::init("-"));
+static cl::opt<std::string> OnlyFunction("function",
+                                         cl::desc("Print the results of this function only"),
+                                         cl::value_desc("name"),
+                                         cl::init(""));
+
+/*
+ * Print the records from Ptr to End, whose values are of type Info. Returns false at the
+ * first record that does not decode.
+ */
+template <class Info>
+static bool decodeRecords(const uint8_t * Ptr, const uint8_t * End, raw_ostream & OS) {
+   while (Ptr != End) {
+      uint64_t nameSize, instructions, numEdges;
+      if (!readULEB128(Ptr, End, nameSize) || nameSize > (uint64_t)(End - Ptr))
+         return false;
+      StringRef name(reinterpret_cast<const char *>(Ptr), nameSize);
+      Ptr += nameSize;
+      if (!readULEB128(Ptr, End, instructions) || !readULEB128(Ptr, End, numEdges) ||
+          numEdges > (uint64_t)(End - Ptr)) {
+         errs() << "decode-results: bad record for function " << name << "\n";
+         return false;
+      }
+
+      std::vector<uint64_t> edges(2 * numEdges);
+      for (uint64_t &node : edges) {
+         if (!readULEB128(Ptr, End, node) || node > instructions) {
+            errs() << "decode-results: bad edge in function " << name << "\n";
+            return false;
+         }
+      }
+
+      std::deque<Info> storage;
+      std::vector<Info *> values, edgeValues;
+      if (!readEdgeValues(Ptr, End, 2 * (instructions + 1), numEdges,
+                          [&storage]() { storage.emplace_back(); return &storage.back(); },
+                          values, edgeValues)) {
+         errs() << "decode-results: bad value in function " << name << "\n";
+         return false;
+      }
+
+      if (!OnlyFunction.empty() && name != OnlyFunction)
+         continue;
+      for (uint64_t e = 0; e < numEdges; e++) {
+         OS << "Edge " << edges[2 * e] << "->" "Edge " << edges[2 * e + 1] << ":";
+         edgeValues[e]->print(OS);
+      }
+   }
+   return true;
+}
+
+int main(int argc, char ** argv) {
+   cl::ParseCommandLineOptions(argc, argv, "Prints binary CSE 231 analysis results as text\n");
+
+   ErrorOr<std::unique_ptr<MemoryBuffer> > buffer = MemoryBuffer::getFileOrSTDIN(InputFile);
+   if (!buffer) {
+      errs() << "decode-results: cannot read " << InputFile << ": " << buffer.getError().message() << "\n";
+      return 1;
+   }
+
+   StringRef contents = (*buffer)->getBuffer();
+   const uint8_t * ptr = contents.bytes_begin();
+   const uint8_t * end = contents.bytes_end();
+   uint64_t version, nameSize;
+   if (!contents.startswith(ResultStream::magic())) {
+      errs() << "decode-results: " << InputFile << " is not a binary results file\n";
+      return 1;
+   }
+   ptr += ResultStream::magic().size();
+   if (!readULEB128(ptr, end, version) || version != ResultStream::Version) {
+      errs() << "decode-results: " << InputFile << " has an unsupported version\n";
+      return 1;
+   }
+   if (!readULEB128(ptr, end, nameSize) || nameSize > (uint64_t)(end - ptr)) {
+      errs() << "decode-results: " << InputFile << " has a bad header\n";
+      return 1;
+   }
+   StringRef analysis(reinterpret_cast<const char *>(ptr), nameSize);
+   ptr += nameSize;
+
+   bool decoded;
+   if (analysis == "cse231-maypointto")
+      decoded = decodeRecords<MayPointToInfo>(ptr, end, outs());
+   else if (analysis == "cse231-reaching" || analysis == "cse231-liveness")
+      decoded = decodeRecords<BitVectorInfo>(ptr, end, outs());
+   else {
+      errs() << "decode-results: unknown analysis " << analysis << "\n";
+      return 1;
+   }
+   outs().flush();
+   return decoded ? 0 : 1;
+}